@@ -8,9 +8,12 @@
 #include<arpa/inet.h>
 #include<netinet/in.h>
 #include<fcntl.h>
+#include<errno.h>
+#include"buffer.hpp"
 
 
 const int MAX_LISTEN = 5;
+const size_t RECV_BUDGET = 256 * 1024;  //RecvNoBlock每次最多读取的字节数，避免一个发送很快的连接长时间占住事件循环
 
 inline void CheckSafe(bool ret)
 {
@@ -59,6 +62,20 @@ class TcpSocket
             return true;
         }
 
+        //开启端口复用，多个套接字可以绑定同一个地址端口，由内核将新连接分散到各个监听套接字上
+        bool SetReuseport()
+        {
+            int opt = 1;
+            int ret = setsockopt(_socket_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+            if(ret < 0)
+            {
+                std::cerr << "set reuseport error" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
         //绑定地址信息
         bool Bind(const std::string& ip, uint16_t& port)
         {
@@ -131,6 +148,39 @@ class TcpSocket
             return true;
         }
 
+        //批量接收新连接，用accept4一直取到全连接队列为空或者取满max个为止
+        //新连接在accept4中直接设置为非阻塞和CLOEXEC，不需要再额外调用两次fcntl
+        //返回本次取到的连接数，新连接的描述符保存在fds中，出错时返回-1
+        int AcceptBatch(int* fds, int max)
+        {
+            int count = 0;
+
+            while(count < max)
+            {
+                int new_fd = accept4(_socket_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+                if(new_fd < 0)
+                {
+                    if(errno == EINTR || errno == ECONNABORTED)
+                    {
+                        continue;
+                    }
+                    //全连接队列已经取空
+                    if(errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        break;
+                    }
+
+                    std::cerr << "accept error" << std::endl;
+                    return count > 0 ? count : -1;
+                }
+
+                fds[count++] = new_fd;
+            }
+
+            return count;
+        }
+
         //发起连接请求
         bool Connect(const std::string& ip, uint16_t port)
         {
@@ -151,37 +201,43 @@ class TcpSocket
             return true;
         }
 
-        //非阻塞发送数据，因为ET模式对于读写的响应只处理一次，所以需要通过轮询的将缓冲区一次性读取完
-        bool SendNoBlock(const std::string& data)
+        //非阻塞发送数据，一直写到数据发送完毕或者发送缓冲区写满为止，不会在EAGAIN上空转
+        //返回实际发送的字节数，发送缓冲区已满时返回0，出错时返回-1，未发送的数据由调用者自行缓存
+        ssize_t SendNoBlock(const char* data, size_t len)
         {
-            ssize_t pos = 0;
-            ssize_t left_size = data.size();
-           
-            while(1)
+            size_t pos = 0;
+
+            while(pos < len)
             {
-                ssize_t ret = send(_socket_fd, data.data() + pos, left_size, 0); 
+                ssize_t ret = send(_socket_fd, data + pos, len - pos, MSG_NOSIGNAL); 
                 if(ret < 0)
                 {
-                    //尝试重新写入
-                    if(errno == EAGAIN || errno == EWOULDBLOCK)
+                    //被信号中断则重新发送
+                    if(errno == EINTR)
                     {
                         continue;
                     }
+                    //发送缓冲区已满，等待EPOLLOUT通知后再继续发送
+                    if(errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        break;
+                    }
 
-                    return false;
+                    return -1;
                 }
 
                 pos += ret;
-                left_size -= ret;
-
-                //如果数据发送完毕
-                if(left_size <= 0)
-                {
-                    break;
-                }
             }
 
-            return true;
+            return pos;
+        }
+
+        //发送全部数据，发送缓冲区写满时返回false，只适用于阻塞套接字，非阻塞套接字需要通过Connection::Send进行缓冲写入
+        bool SendAll(const std::string& data)
+        {
+            ssize_t ret = SendNoBlock(data.data(), data.size());
+
+            return ret == (ssize_t)data.size();
         }
 
         //发送数据
@@ -198,24 +254,35 @@ class TcpSocket
         }
 
 
-        //非阻塞接收数据
-        bool RecvNoBlock(std::string& data)
+        //非阻塞接收数据，将套接字接收缓冲区中的数据读入buff尾部，数据中可以包含'\0'
+        //ET模式下只通知一次，所以需要一直读到接收缓冲区为空为止，但每次最多读取max_bytes字节
+        //读满max_bytes时停下并将more置为true，剩下的数据由调用者重新激活监控后在下一轮事件循环中读取
+        //对端关闭或出错时返回false，此前已经读到的数据仍然保留在buff中
+        bool RecvNoBlock(Buffer& buff, size_t max_bytes = RECV_BUDGET, bool* more = NULL)
         {
-            data.clear();
-            char buff[4096] = { 0 };
+            size_t total = 0;
+
+            if(more != NULL)
+            {
+                *more = false;
+            }
 
             while(1)
             {
-                ssize_t ret = recv(_socket_fd, buff, 4096, 0);
+                int saved_errno = 0;
+                ssize_t ret = buff.ReadFd(_socket_fd, &saved_errno);
                 
-                //没有内容
                 if(ret < 0)
                 {
-                    //尝试重新写入
-                    if(errno == EAGAIN || errno == EWOULDBLOCK)
+                    if(saved_errno == EINTR)
                     {
                         continue;
                     }
+                    //接收缓冲区已经读空
+                    if(saved_errno == EAGAIN || saved_errno == EWOULDBLOCK)
+                    {
+                        break;
+                    }
 
                     return false;
                 }
@@ -225,12 +292,15 @@ class TcpSocket
                     return false;
                 }
 
-                buff[ret] = '\0';
-                data += buff;
-                
-                //如果当前接受数据小于缓冲区长度，则说明数据全部接收完毕,反之则说明还需要多次轮询接收
-                if(ret < 4096)
+                //即使没有读满也要继续读到EAGAIN，最后的数据和FIN同时到达时只有一次通知
+                //如果在这里停下，读不到0就发现不了对端关闭，连接会一直停留在CLOSE_WAIT
+                total += ret;
+                if(total >= max_bytes)
                 {
+                    if(more != NULL)
+                    {
+                        *more = true;
+                    }
                     break;
                 }
             }
@@ -0,0 +1,224 @@
+#ifndef __BUFFER_H_
+#define __BUFFER_H_
+
+#include<string>
+#include<vector>
+#include<cstring>
+#include<algorithm>
+#include<errno.h>
+#include<sys/uio.h>
+
+const size_t BUFFER_CHEAP_PREPEND = 8;     //头部预留空间，方便在数据前面追加长度等协议头
+const size_t BUFFER_INITIAL_SIZE = 1024;    //初始可写空间
+const size_t BUFFER_EXTRA_SIZE = 65536;     //readv使用的栈上溢出区大小
+
+//连接的输入输出缓冲区，内存布局如下
+//| prependable | readable | writable |
+//0        _read_index  _write_index  size
+//数据从_write_index写入，从_read_index读出，解析时可以直接在Peek()返回的内存上进行，不需要拷贝
+class Buffer
+{
+    public:
+        Buffer(size_t initial_size = BUFFER_INITIAL_SIZE)
+            : _buffer(BUFFER_CHEAP_PREPEND + initial_size)
+            , _read_index(BUFFER_CHEAP_PREPEND)
+            , _write_index(BUFFER_CHEAP_PREPEND)
+        {}
+
+        //可读数据长度
+        size_t ReadableBytes() const
+        {
+            return _write_index - _read_index;
+        }
+
+        //可写空间长度
+        size_t WritableBytes() const
+        {
+            return _buffer.size() - _write_index;
+        }
+
+        //头部可用空间长度
+        size_t PrependableBytes() const
+        {
+            return _read_index;
+        }
+
+        //可读数据的起始位置
+        const char* Peek() const
+        {
+            return Begin() + _read_index;
+        }
+
+        //在可读数据中查找分隔符，找不到返回nullptr
+        const char* Find(const char* delim, size_t len) const
+        {
+            const char* pos = std::search(Peek(), BeginWrite(), delim, delim + len);
+
+            return pos == BeginWrite() ? nullptr : pos;
+        }
+
+        //查找\r\n
+        const char* FindCRLF() const
+        {
+            return Find("\r\n", 2);
+        }
+
+        //取走len字节数据，只移动读位置
+        void Retrieve(size_t len)
+        {
+            if(len < ReadableBytes())
+            {
+                _read_index += len;
+            }
+            else
+            {
+                RetrieveAll();
+            }
+        }
+
+        //取走end之前的所有数据
+        void RetrieveUntil(const char* end)
+        {
+            Retrieve(end - Peek());
+        }
+
+        //取走全部数据，读写位置复位，避免缓冲区无限后移
+        void RetrieveAll()
+        {
+            _read_index = BUFFER_CHEAP_PREPEND;
+            _write_index = BUFFER_CHEAP_PREPEND;
+        }
+
+        std::string RetrieveAsString(size_t len)
+        {
+            len = std::min(len, ReadableBytes());
+            std::string str(Peek(), len);
+            Retrieve(len);
+
+            return str;
+        }
+
+        std::string RetrieveAllAsString()
+        {
+            return RetrieveAsString(ReadableBytes());
+        }
+
+        //在尾部追加数据
+        void Append(const char* data, size_t len)
+        {
+            EnsureWritableBytes(len);
+            std::copy(data, data + len, BeginWrite());
+            HasWritten(len);
+        }
+
+        void Append(const std::string& data)
+        {
+            Append(data.data(), data.size());
+        }
+
+        //在可读数据前面追加数据，例如协议头
+        void Prepend(const void* data, size_t len)
+        {
+            if(len > PrependableBytes())
+            {
+                return;
+            }
+
+            _read_index -= len;
+            const char* d = (const char*)data;
+            std::copy(d, d + len, Begin() + _read_index);
+        }
+
+        //确保有足够的可写空间
+        void EnsureWritableBytes(size_t len)
+        {
+            if(WritableBytes() < len)
+            {
+                MakeSpace(len);
+            }
+        }
+
+        char* BeginWrite()
+        {
+            return Begin() + _write_index;
+        }
+
+        const char* BeginWrite() const
+        {
+            return Begin() + _write_index;
+        }
+
+        void HasWritten(size_t len)
+        {
+            _write_index += len;
+        }
+
+        //从描述符中读取数据，一次readv同时读入缓冲区尾部和栈上的64KB溢出区
+        //这样缓冲区平时不需要预留很大的空间，突发的大量数据也只需要一次系统调用就能读完
+        //返回值与read相同，出错时通过saved_errno返回错误码
+        ssize_t ReadFd(int fd, int* saved_errno)
+        {
+            char extrabuf[BUFFER_EXTRA_SIZE];
+            struct iovec vec[2];
+            const size_t writable = WritableBytes();
+
+            vec[0].iov_base = BeginWrite();
+            vec[0].iov_len = writable;
+            vec[1].iov_base = extrabuf;
+            vec[1].iov_len = sizeof(extrabuf);
+
+            //缓冲区本身的可写空间已经足够大时就不再使用溢出区
+            const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
+            const ssize_t n = readv(fd, vec, iovcnt);
+
+            if(n < 0)
+            {
+                *saved_errno = errno;
+            }
+            else if((size_t)n <= writable)
+            {
+                _write_index += n;
+            }
+            else
+            {
+                //溢出区中的数据追加到缓冲区中，此时才会扩容
+                _write_index = _buffer.size();
+                Append(extrabuf, n - writable);
+            }
+
+            return n;
+        }
+
+    private:
+        char* Begin()
+        {
+            return &*_buffer.begin();
+        }
+
+        const char* Begin() const
+        {
+            return &*_buffer.begin();
+        }
+
+        //腾出len字节的可写空间，头部空闲空间足够时将数据前移，否则扩容
+        void MakeSpace(size_t len)
+        {
+            if(WritableBytes() + PrependableBytes() < len + BUFFER_CHEAP_PREPEND)
+            {
+                _buffer.resize(_write_index + len);
+            }
+            else
+            {
+                size_t readable = ReadableBytes();
+                std::copy(Begin() + _read_index, Begin() + _write_index, Begin() + BUFFER_CHEAP_PREPEND);
+                _read_index = BUFFER_CHEAP_PREPEND;
+                _write_index = _read_index + readable;
+            }
+        }
+
+        std::vector<char> _buffer;
+        size_t _read_index;     //读位置
+        size_t _write_index;    //写位置
+};
+
+#endif
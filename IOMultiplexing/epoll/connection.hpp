@@ -0,0 +1,239 @@
+#ifndef __CONNECTION_H_
+#define __CONNECTION_H_
+
+#include<string>
+#include"TcpSocket.hpp"
+#include"buffer.hpp"
+#include"epoll.hpp"
+
+const size_t DEFAULT_HIGH_WATER_MARK = 64 * 1024 * 1024;
+
+class Connection;
+
+//水位回调，参数为当前输出缓冲区中积压的字节数
+typedef void (*WaterMarkCallback)(Connection* conn, size_t buffered);
+
+//连接上下文，注册到epoll时存放在epoll_event.data.ptr中
+//事件就绪时直接取回连接对象，不需要再通过描述符查找，也不需要每轮重新构造TcpSocket
+class Connection
+{
+    public:
+        Connection(int fd)
+            : _epoll(nullptr)
+            , _events(0)
+            , _high_water_mark(DEFAULT_HIGH_WATER_MARK)
+            , _low_water_mark(0)
+            , _high_water_cb(nullptr)
+            , _low_water_cb(nullptr)
+        {
+            _socket.SetFd(fd);
+        }
+
+        int GetFd() const
+        {
+            return _socket.GetFd();
+        }
+
+        TcpSocket& GetSocket()
+        {
+            return _socket;
+        }
+
+        //输入缓冲区，解析数据时直接在缓冲区上进行，处理完后调用Retrieve取走
+        Buffer& GetInputBuffer()
+        {
+            return _input;
+        }
+
+        //将套接字中的数据读入输入缓冲区，对端关闭或出错时返回false
+        //一次最多读取RECV_BUDGET字节，读满时重新激活监控，ET模式下套接字中还有数据会再次就绪，排在本轮其他连接之后处理
+        bool HandleRead()
+        {
+            bool more = false;
+            if(!_socket.RecvNoBlock(_input, RECV_BUDGET, &more))
+            {
+                return false;
+            }
+
+            //EPOLLONESHOT连接由处理线程最后统一Rearm，这里提前激活会让其他线程拿到同一个连接
+            if(more && _epoll != nullptr && !(_events & EPOLLONESHOT))
+            {
+                return _epoll->Rearm(GetFd());
+            }
+
+            return true;
+        }
+
+        //将连接加入epoll监控，之后可写事件的开关都由连接自己维护
+        bool Register(Epoll* epoll, uint32_t events = EPOLLIN)
+        {
+            _epoll = epoll;
+            _events = events;
+
+            return _epoll->Add(GetFd(), this, _events);
+        }
+
+        //输出缓冲区积压超过高水位时回调，可用于暂停读取，对上游施加背压
+        void SetHighWaterMark(size_t mark, WaterMarkCallback cb)
+        {
+            _high_water_mark = mark;
+            _high_water_cb = cb;
+        }
+
+        //输出缓冲区回落到低水位以下时回调，可用于恢复读取
+        void SetLowWaterMark(size_t mark, WaterMarkCallback cb)
+        {
+            _low_water_mark = mark;
+            _low_water_cb = cb;
+        }
+
+        //输出缓冲区中尚未发送的字节数
+        size_t OutputBytes() const
+        {
+            return _output.ReadableBytes();
+        }
+
+        //缓冲发送数据，先尽量直接写入套接字，写不完的部分放入输出缓冲区并开启可写事件监控
+        bool Send(const char* data, size_t len)
+        {
+            size_t sent = 0;
+
+            //输出缓冲区中还有积压时必须排在后面，不能直接发送，否则会打乱数据顺序
+            if(OutputBytes() == 0)
+            {
+                ssize_t ret = _socket.SendNoBlock(data, len);
+                if(ret < 0)
+                {
+                    return false;
+                }
+                sent = ret;
+            }
+
+            if(sent == len)
+            {
+                return true;
+            }
+
+            size_t old_bytes = OutputBytes();
+            _output.Append(data + sent, len - sent);
+
+            //积压刚刚越过高水位时通知上层
+            if(old_bytes < _high_water_mark && OutputBytes() >= _high_water_mark && _high_water_cb != nullptr)
+            {
+                _high_water_cb(this, OutputBytes());
+            }
+
+            return EnableWriting();
+        }
+
+        bool Send(const std::string& data)
+        {
+            return Send(data.data(), data.size());
+        }
+
+        //可写事件就绪时调用，将输出缓冲区中的数据尽量发出，发送完毕后关闭可写事件监控
+        bool HandleWrite()
+        {
+            size_t old_bytes = OutputBytes();
+            if(old_bytes == 0)
+            {
+                return DisableWriting();
+            }
+
+            ssize_t ret = _socket.SendNoBlock(_output.Peek(), old_bytes);
+            if(ret < 0)
+            {
+                return false;
+            }
+            //全部取走时缓冲区读写位置会复位，空间可以重复利用
+            _output.Retrieve(ret);
+
+            //数据全部发送完毕，关闭可写事件，避免LT模式下空转
+            if(OutputBytes() == 0)
+            {
+                DisableWriting();
+            }
+
+            //积压回落到低水位以下时通知上层
+            if(old_bytes > _low_water_mark && OutputBytes() <= _low_water_mark && _low_water_cb != nullptr)
+            {
+                _low_water_cb(this, OutputBytes());
+            }
+
+            return true;
+        }
+
+        bool EnableReading()
+        {
+            return UpdateEvents(_events | EPOLLIN);
+        }
+
+        bool DisableReading()
+        {
+            return UpdateEvents(_events & ~EPOLLIN);
+        }
+
+        bool EnableWriting()
+        {
+            return UpdateEvents(_events | EPOLLOUT);
+        }
+
+        bool DisableWriting()
+        {
+            return UpdateEvents(_events & ~EPOLLOUT);
+        }
+
+        //移除监控并关闭连接
+        void Close()
+        {
+            if(_epoll != nullptr)
+            {
+                _epoll->Del(GetFd());
+                _epoll = nullptr;
+            }
+            _socket.Close();
+        }
+
+        //以EPOLLONESHOT方式注册的连接处理完毕后调用，按当前的读写需求重新激活监控
+        bool Rearm()
+        {
+            if(_epoll == nullptr)
+            {
+                return false;
+            }
+
+            return _epoll->Mod(GetFd(), this, _events);
+        }
+
+    private:
+        //只有监控事件真正发生变化时才调用epoll_ctl
+        bool UpdateEvents(uint32_t events)
+        {
+            if(events == _events || _epoll == nullptr)
+            {
+                return true;
+            }
+
+            _events = events;
+
+            //EPOLLONESHOT连接在处理期间修改监控会提前重新激活，导致其他线程拿到同一个连接，所以只记录下来，等Rearm时统一生效
+            if(_events & EPOLLONESHOT)
+            {
+                return true;
+            }
+
+            return _epoll->Mod(GetFd(), this, _events);
+        }
+
+        TcpSocket _socket;
+        Epoll* _epoll;          //连接所属的epoll
+        uint32_t _events;       //当前监控的事件
+        Buffer _input;          //输入缓冲区
+        Buffer _output;         //输出缓冲区
+        size_t _high_water_mark;
+        size_t _low_water_mark;
+        WaterMarkCallback _high_water_cb;
+        WaterMarkCallback _low_water_cb;
+};
+
+#endif
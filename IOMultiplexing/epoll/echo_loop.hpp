@@ -0,0 +1,111 @@
+#ifndef __ECHO_LOOP_H_
+#define __ECHO_LOOP_H_
+
+#include<iostream>
+#include<string>
+#include"TcpSocket.hpp"
+#include"epoll.hpp"
+#include"connection.hpp"
+
+const size_t HIGH_WATER_MARK = 4 * 1024 * 1024;
+const size_t LOW_WATER_MARK = 1024 * 1024;
+const int ACCEPT_BATCH = 64;    //每轮最多接收的新连接数，防止连接风暴时饿死已有连接
+
+//输出缓冲区积压过多，说明对端读取太慢，暂停读取该连接，对其施加背压
+inline void on_high_water(Connection* conn, size_t buffered)
+{
+    std::cerr << "fd " << conn->GetFd() << " output buffered " << buffered << " bytes, stop reading" << std::endl;
+    conn->DisableReading();
+}
+
+//积压回落后恢复读取
+inline void on_low_water(Connection* conn, size_t /*buffered*/)
+{
+    conn->EnableReading();
+}
+
+//关闭连接并释放连接对象
+inline void close_conn(Connection* conn)
+{
+    conn->Close();
+    delete conn;
+}
+
+//边缘触发的epoll回显事件循环，epoll_et_srv和epoll_mr_srv的每个reactor线程共用
+//监听套接字需要已经开始监听；spin_us为自适应等待的空转上限，为0时不空转；tag为日志前缀，用于区分reactor
+inline void run_echo_loop(TcpSocket& lst_socket, int spin_us, const std::string& tag)
+{
+    lst_socket.SetNoBlock();
+
+    Epoll epoll;
+    epoll.SetBusyPoll(spin_us);
+    //监听套接字同样以连接上下文的形式注册，就绪时通过指针比较即可区分
+    Connection listener(lst_socket.GetFd());
+    listener.Register(&epoll);
+
+    while(1)
+    {
+        int ret = epoll.Wait();
+        if(ret <= 0)
+        {
+            continue;
+        }
+
+        for(int i = 0; i < ret; i++)
+        {
+            Connection* conn = (Connection*)epoll.GetPtr(i);
+
+            //如果就绪的是监听套接字，则说明有新连接到来
+            if(conn == &listener)
+            {
+                //一次取出全连接队列中的多个连接，每轮最多取ACCEPT_BATCH个，剩下的由水平触发的监听套接字在下一轮继续通知
+                int fds[ACCEPT_BATCH];
+                int count = lst_socket.AcceptBatch(fds, ACCEPT_BATCH);
+
+                //将新连接统一注册到epoll中
+                for(int j = 0; j < count; j++)
+                {
+                    Connection* new_conn = new Connection(fds[j]);
+                    new_conn->SetHighWaterMark(HIGH_WATER_MARK, on_high_water);
+                    new_conn->SetLowWaterMark(LOW_WATER_MARK, on_low_water);
+                    new_conn->Register(&epoll, EPOLLIN | EPOLLET);
+                }
+                continue;
+            }
+
+            //如果不是，则说明已连接的套接字有新数据到来
+            uint32_t events = epoll.GetEvents(i);
+
+            //可写事件就绪，发送输出缓冲区中积压的数据
+            if((events & EPOLLOUT) && !conn->HandleWrite())
+            {
+                close_conn(conn);
+                continue;
+            }
+
+            if(events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+            {
+                //接收数据，断开连接时移除监控
+                if(!conn->HandleRead())
+                {
+                    close_conn(conn);
+                    continue;
+                }
+
+                Buffer& input = conn->GetInputBuffer();
+                std::cout << tag << "cli send message: ";
+                std::cout.write(input.Peek(), input.ReadableBytes()) << std::endl;
+
+                //直接从输入缓冲区回显数据，发送不完的部分由连接缓存，等待可写事件再发送
+                bool ok = conn->Send(input.Peek(), input.ReadableBytes());
+                input.RetrieveAll();
+                if(!ok)
+                {
+                    close_conn(conn);
+                }
+            }
+        }
+    }
+}
+
+#endif
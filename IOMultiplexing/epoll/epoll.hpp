@@ -1,18 +1,33 @@
 #ifndef __EPOLL_H_
-#define __EPOLL_H_ 
+#define __EPOLL_H_
 
 #include<iostream>
 #include<vector>
+#include<algorithm>
 #include<sys/epoll.h>
 #include<unistd.h>
+#include<errno.h>
+#include<time.h>
 #include"TcpSocket.hpp"
 
 const int EPOLL_SIZE = 1000;
+const int EPOLL_FD_LIMIT = 65536;   //缓存监控事件的描述符上限，超过上限的描述符不缓存，每次都直接调用epoll_ctl
+const int EPOLL_MIN_SPIN_US = 10;   //自适应等待的最小空转时间
+
+//描述符当前在epoll中的监控状态
+struct EpollInterest
+{
+    bool registered;    //是否已经加入epoll
+    uint32_t events;    //当前监控的事件
+    epoll_data_t data;  //注册时的用户数据
+};
 
 class Epoll
 {
     public:
         Epoll()
+            : _max_spin_us(0)
+            , _spin_us(0)
         {
             //现版本已经忽略size，随便给一个大于0的数字即可
             _epfd = epoll_create(1);
@@ -22,92 +37,281 @@ class Epoll
                 std::cerr << "epoll create error" << std::endl;
                 exit(0);
             }
+
+            //按描述符下标缓存监控状态，数组大小固定，工作线程重新激活描述符时不会与扩容产生竞争
+            _interest = new EpollInterest[EPOLL_FD_LIMIT]();
         }
 
         ~Epoll()
         {
+            delete[] _interest;
             close(_epfd);
         }
 
+        //防拷贝
+        Epoll(const Epoll&) = delete;
+        Epoll& operator=(const Epoll&) = delete;
+
         //增加新的监控事件
-        bool Add(const TcpSocket& socket, bool epoll_et = false, uint32_t events = EPOLLIN) const
+        bool Add(const TcpSocket& socket, bool epoll_et = false, uint32_t events = EPOLLIN)
         {
             int fd = socket.GetFd();
 
             //组织监控事件结构体
-            struct epoll_event ev;
-            ev.data.fd = fd;//设置需要监控的描述符
+            epoll_data_t data;
+            data.fd = fd;//设置需要监控的描述符
 
             if(epoll_et == true)
             {
-                ev.events = events | EPOLLET;
+                events |= EPOLLET;
             }
-            else
-            {   
-                ev.events = events;
+
+            return Ctl(EPOLL_CTL_ADD, fd, events, data);
+        }
+
+        //增加新的监控事件，并将连接上下文指针存入data.ptr中，事件就绪时可以直接取回连接对象，无需再通过描述符查找
+        bool Add(int fd, void* ptr, uint32_t events = EPOLLIN)
+        {
+            epoll_data_t data;
+            data.ptr = ptr;
+
+            return Ctl(EPOLL_CTL_ADD, fd, events, data);
+        }
+
+        //以EPOLLONESHOT方式增加监控事件，事件触发一次后内核自动停止监控，直到调用Rearm重新激活
+        //这样reactor把就绪连接交给线程池后，在处理完之前不会有第二个线程拿到同一个描述符
+        bool AddOneShot(int fd, void* ptr, uint32_t events = EPOLLIN)
+        {
+            return Add(fd, ptr, events | EPOLLONESHOT);
+        }
+
+        //修改监控事件，用于开启或关闭对可写事件的监控，事件没有变化时不会调用epoll_ctl
+        bool Mod(int fd, void* ptr, uint32_t events)
+        {
+            //EPOLLONESHOT的修改同时起到重新激活的作用，不能省略
+            if(fd >= 0 && fd < EPOLL_FD_LIMIT && !(events & EPOLLONESHOT))
+            {
+                const EpollInterest& interest = _interest[fd];
+                if(interest.registered && interest.events == events && interest.data.ptr == ptr)
+                {
+                    return true;
+                }
             }
-            
-            int ret = epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev);
-            if(ret < 0)
+
+            epoll_data_t data;
+            data.ptr = ptr;
+
+            return Ctl(EPOLL_CTL_MOD, fd, events, data);
+        }
+
+        //按缓存的监控事件重新激活EPOLLONESHOT描述符，由处理完该连接的线程调用
+        bool Rearm(int fd)
+        {
+            if(fd < 0 || fd >= EPOLL_FD_LIMIT || !_interest[fd].registered)
             {
-                std::cerr << "epoll ctl add error " << std::endl;
+                std::cerr << "epoll rearm unknown fd" << std::endl;
                 return false;
             }
 
-            return true;
+            const EpollInterest& interest = _interest[fd];
+            return Ctl(EPOLL_CTL_MOD, fd, interest.events, interest.data);
+        }
+
+        //获取描述符当前监控的事件，未注册或者超出缓存上限时返回0
+        uint32_t GetInterest(int fd) const
+        {
+            if(fd < 0 || fd >= EPOLL_FD_LIMIT || !_interest[fd].registered)
+            {
+                return 0;
+            }
+
+            return _interest[fd].events;
         }
 
         //删除监控事件
-        bool Del(const TcpSocket& socket) const 
+        bool Del(const TcpSocket& socket)
+        {
+            return Del(socket.GetFd());
+        }
+
+        bool Del(int fd)
         {
-            int fd = socket.GetFd();
-            
             int ret = epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, NULL);
+            if(fd >= 0 && fd < EPOLL_FD_LIMIT)
+            {
+                _interest[fd].registered = false;
+            }
+
             if(ret < 0)
             {
                 std::cerr << "epoll ctl del error" << std::endl;
                 return false;
             }
-            
+
             return true;
         }
 
         //开始监控
-        bool Wait(std::vector<TcpSocket>& vec, int timeout = 3000) const 
+        bool Wait(std::vector<TcpSocket>& vec, int timeout = 3000)
         {
             vec.clear();
-            struct epoll_event evs[EPOLL_SIZE];
-            
+
             //开始监控，返回值为就绪描述符数量
-            int ret = epoll_wait(_epfd, evs, EPOLL_SIZE, timeout);
-            
+            int ret = epoll_wait(_epfd, _evs, EPOLL_SIZE, timeout);
+
             //当前没有描述符就绪
             if(ret < 0)
             {
                 std::cerr << "epoll not ready" << std::endl;
                 return false;
             }
-            //等待超时
+            //等待超时，空闲时属于正常情况，不再打印日志
             else if(ret == 0)
             {
-                std::cerr << "epoll wait timeout" << std::endl;
                 return false;
             }
-            
+
             for(int i = 0; i < ret; i++)
             {
                 //将所有就绪描述符放进数组中
                 TcpSocket new_socket;
-                new_socket.SetFd(evs[i].data.fd);
+                new_socket.SetFd(_evs[i].data.fd);
                 vec.push_back(new_socket);
             }
 
             return true;
         }
 
+        //开启自适应等待，max_spin_us为0时关闭
+        //开启后Wait先以0超时反复轮询一段时间，仍然没有事件才进入阻塞等待，用空闲时的CPU换取更低的唤醒延迟
+        //只适合在独占的CPU核心上使用
+        void SetBusyPoll(int max_spin_us)
+        {
+            _max_spin_us = max_spin_us > 0 ? max_spin_us : 0;
+            _spin_us = _max_spin_us;
+        }
+
+        //开始监控，就绪事件保存在成员数组中，返回就绪事件数量，出错返回-1，超时返回0
+        //配合GetPtr和GetEvents直接遍历就绪事件，每轮循环不再构造任何对象
+        int Wait(int timeout = 3000)
+        {
+            if(_max_spin_us > 0 && timeout != 0)
+            {
+                int ret = SpinWait();
+                if(ret != 0)
+                {
+                    return ret;
+                }
+            }
+
+            int ret = epoll_wait(_epfd, _evs, EPOLL_SIZE, timeout);
+
+            if(ret < 0 && errno != EINTR)
+            {
+                std::cerr << "epoll wait error" << std::endl;
+                return -1;
+            }
+
+            return ret < 0 ? 0 : ret;
+        }
+
+        //获取第i个就绪事件注册时存放的上下文指针
+        void* GetPtr(int i) const
+        {
+            return _evs[i].data.ptr;
+        }
+
+        //获取第i个就绪事件的事件类型
+        uint32_t GetEvents(int i) const
+        {
+            return _evs[i].events;
+        }
+
     private:
+        static long long NowUs()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+
+            return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+        }
+
+        //在空转预算内以0超时反复轮询，预算根据最近的事件情况自适应调整
+        //空转期间等到了事件说明负载较高，预算翻倍，直到上限；空转落空说明比较空闲，预算减半，减少CPU浪费
+        int SpinWait()
+        {
+            long long deadline = NowUs() + _spin_us;
+
+            do
+            {
+                int ret = epoll_wait(_epfd, _evs, EPOLL_SIZE, 0);
+                if(ret != 0)
+                {
+                    if(ret > 0)
+                    {
+                        _spin_us = std::min(_spin_us * 2, _max_spin_us);
+                    }
+                    else if(errno == EINTR)
+                    {
+                        return 0;
+                    }
+                    else
+                    {
+                        std::cerr << "epoll wait error" << std::endl;
+                    }
+                    return ret;
+                }
+            } while(NowUs() < deadline);
+
+            _spin_us = std::max(_spin_us / 2, std::min(EPOLL_MIN_SPIN_US, _max_spin_us));
+            return 0;
+        }
+
+        //更新缓存的监控状态并调用epoll_ctl
+        //缓存必须在epoll_ctl之前更新，调用返回前事件就可能已经触发，工作线程随即Mod或Rearm时要看到新的监控事件
+        bool Ctl(int op, int fd, uint32_t events, epoll_data_t data)
+        {
+            bool cached = (fd >= 0 && fd < EPOLL_FD_LIMIT);
+            EpollInterest old;
+
+            if(cached)
+            {
+                old = _interest[fd];
+                _interest[fd].registered = true;
+                _interest[fd].events = events;
+                _interest[fd].data = data;
+            }
+
+            struct epoll_event ev;
+            ev.data = data;
+            ev.events = events;
+
+            int ret = epoll_ctl(_epfd, op, fd, &ev);
+            if(ret < 0)
+            {
+                //调用失败时恢复原来的状态
+                if(cached)
+                {
+                    _interest[fd] = old;
+                }
+
+                std::cerr << (op == EPOLL_CTL_ADD ? "epoll ctl add error " : "epoll ctl mod error ") << std::endl;
+                return false;
+            }
+
+            return true;
+        }
+
         //epoll的操作句柄
         int _epfd;
+        //就绪事件数组，作为成员复用，避免每次监控都在栈上重新构造
+        struct epoll_event _evs[EPOLL_SIZE];
+        //每个描述符当前的监控状态
+        EpollInterest* _interest;
+        //自适应等待的空转时间上限，为0时不空转
+        int _max_spin_us;
+        //当前的空转预算
+        int _spin_us;
 };
 
 #endif
@@ -3,21 +3,182 @@
 #include <sys/socket.h>
 #include"TcpSocket.hpp"
 #include"epoll.hpp"
+#include"connection.hpp"
+#include"echo_loop.hpp"
+#include"uring.hpp"
 
 using namespace std;
 
+//uring模式下的连接上下文，发送中的数据必须保持不动直到完成事件返回，所以收发各用一个缓冲区
+struct UringConn
+{
+    UringConn(int fd)
+        : _fd(fd)
+        , _recving(false)
+        , _sending(false)
+        , _closing(false)
+    {}
+
+    int _fd;
+    Buffer _input;      //新收到还未发送的数据
+    Buffer _output;     //正在发送的数据
+    bool _recving;      //multishot recv是否仍然有效
+    bool _sending;      //是否有发送请求未完成
+    bool _closing;      //连接是否正在关闭
+};
+
+//没有正在发送的数据时，将新收到的数据交换到输出缓冲区中发出
+void uring_send(Uring& uring, UringConn* conn)
+{
+    if(conn->_sending || conn->_closing)
+    {
+        return;
+    }
+
+    if(conn->_output.ReadableBytes() == 0)
+    {
+        if(conn->_input.ReadableBytes() == 0)
+        {
+            return;
+        }
+        std::swap(conn->_input, conn->_output);
+    }
+
+    uring.AddSend(conn->_fd, conn->_output.Peek(), conn->_output.ReadableBytes(), conn);
+    conn->_sending = true;
+}
+
+//关闭连接，必须等到该连接上所有请求都返回完成事件后才能释放上下文
+void uring_close(Uring& uring, UringConn* conn)
+{
+    if(!conn->_closing)
+    {
+        conn->_closing = true;
+        if(conn->_recving)
+        {
+            uring.Del(conn->_fd, conn);
+        }
+    }
+
+    if(!conn->_recving && !conn->_sending)
+    {
+        close(conn->_fd);
+        delete conn;
+    }
+}
+
+//io_uring引擎，accept和recv都是multishot请求，数据直接由内核写入缓冲区环
+void run_uring(TcpSocket& lst_socket)
+{
+    Uring uring;
+    //监听套接字的上下文只用于区分事件，不会被解引用
+    static UringConn listener(lst_socket.GetFd());
+    uring.AddAccept(lst_socket.GetFd(), &listener);
+
+    while(1)
+    {
+        int ret = uring.Wait();
+        if(ret <= 0)
+        {
+            continue;
+        }
+
+        for(int i = 0; i < ret; i++)
+        {
+            UringConn* conn = (UringConn*)uring.GetPtr(i);
+            int res = uring.GetResult(i);
+
+            switch(uring.GetOp(i))
+            {
+                //新连接到来，直接发起multishot recv
+                case URING_ACCEPT:
+                {
+                    if(res >= 0)
+                    {
+                        UringConn* new_conn = new UringConn(res);
+                        new_conn->_recving = true;
+                        uring.AddRecv(res, new_conn);
+                    }
+                    //multishot accept失效后重新提交
+                    if(!uring.HasMore(i))
+                    {
+                        uring.AddAccept(lst_socket.GetFd(), &listener);
+                    }
+                    break;
+                }
+                //数据到来
+                case URING_RECV:
+                {
+                    uint16_t bid;
+                    const char* data = uring.GetBuffer(i, &bid);
+                    if(res > 0 && data != nullptr)
+                    {
+                        cout << "cli send message: ";
+                        cout.write(data, res) << endl;
+
+                        //拷贝到输入缓冲区后立即归还内核缓冲区
+                        conn->_input.Append(data, res);
+                        uring.RecycleBuffer(bid);
+                        uring_send(uring, conn);
+                    }
+                    else if(data != nullptr)
+                    {
+                        uring.RecycleBuffer(bid);
+                    }
 
+                    if(!uring.HasMore(i))
+                    {
+                        conn->_recving = false;
+                        //内核缓冲区用完或者请求被内核终止时，连接仍然有效，重新提交
+                        if(!conn->_closing && (res > 0 || res == -ENOBUFS))
+                        {
+                            conn->_recving = true;
+                            uring.AddRecv(conn->_fd, conn);
+                        }
+                        //对端关闭或者出错
+                        else
+                        {
+                            uring_close(uring, conn);
+                        }
+                    }
+                    break;
+                }
+                //数据发送完成
+                case URING_SEND:
+                {
+                    conn->_sending = false;
+                    if(res < 0 || conn->_closing)
+                    {
+                        uring_close(uring, conn);
+                        break;
+                    }
+
+                    //没有发完的部分继续发送
+                    conn->_output.Retrieve(res);
+                    uring_send(uring, conn);
+                    break;
+                }
+                //取消请求的完成事件，被取消的请求会单独返回，这里不需要处理
+                default:
+                {
+                    break;
+                }
+            }
+        }
+    }
+}
 
 int main(int argc, char* argv[])
 {
-	if(argc != 3)
+	if(argc != 3 && argc != 4)
 	{   
-		cerr << "正确输入方式: ./epoll_et_srv ip port\n" << endl;
+		cerr << "正确输入方式: ./epoll_et_srv ip port [epoll|uring]\n" << endl;
 		return -1; 
 	} 
 
 	string srv_ip = argv[1];
 	uint16_t srv_port = stoi(argv[2]);
+	string engine = (argc == 4) ? argv[3] : "epoll";
 
 	TcpSocket lst_socket;
 	//创建监听套接字
@@ -26,60 +187,17 @@ int main(int argc, char* argv[])
 	CheckSafe(lst_socket.Bind(srv_ip, srv_port));
 	//开始监听
 	CheckSafe(lst_socket.Listen());
-    lst_socket.SetNoBlock();
-    Epoll epoll;
-    epoll.Add(lst_socket);
-	
 
-	while(1)
+	//启动时选择事件引擎
+	if(engine == "uring")
 	{
-        vector<TcpSocket> vec;
-		int ret = epoll.Wait(vec);
-        if(ret <= 0)
-        {
-            continue;
-        }
-        
-        for(auto& socket : vec)
-        {
-            //如果就绪的是监听套接字，则说明有新连接到来
-            if(socket.GetFd() == lst_socket.GetFd())
-            {
-                TcpSocket new_socket;
-                lst_socket.Accept(&new_socket);
-                new_socket.SetNoBlock();
-                epoll.Add(new_socket, true);
-            }
-            //如果不是，则说明已连接的套接字有新数据到来
-            else
-            {   
-                string data;
-                //接收数据
-                bool ret = socket.RecvNoBlock(data);
-
-
-                //断开连接，移除监控
-                if(!ret)
-                {   
-                    epoll.Del(socket);
-                    socket.Close();
-                    continue;
-                }   
-
-                cout << "cli send message: " << data << endl;
-                data.clear();
-
-                if(ret == false)
-                {   
-                    epoll.Del(socket);
-                    socket.Close();
-                    continue;
-                }   
-			}
-        }
+		run_uring(lst_socket);
+	}
+	else
+	{
+		run_echo_loop(lst_socket, 0, "");
 	}
 
 	lst_socket.Close();
 	return 0;
 }
-
@@ -3,6 +3,7 @@
 #include <sys/socket.h>
 #include"TcpSocket.hpp"
 #include"epoll.hpp"
+#include"connection.hpp"
 
 using namespace std;
 
@@ -27,51 +28,52 @@ int main(int argc, char* argv[])
 	//开始监听
 	CheckSafe(lst_socket.Listen());
     Epoll epoll;
-    epoll.Add(lst_socket);
+    //监听套接字同样以连接上下文的形式注册，就绪时通过指针比较即可区分
+    Connection listener(lst_socket.GetFd());
+    epoll.Add(listener.GetFd(), &listener);
 	
 
 	while(1)
 	{
-        vector<TcpSocket> vec;
-		int ret = epoll.Wait(vec);
+		int ret = epoll.Wait();
         if(ret <= 0)
         {
             continue;
         }
         
-        for(auto& socket : vec)
+        for(int i = 0; i < ret; i++)
         {
+            Connection* conn = (Connection*)epoll.GetPtr(i);
+
             //如果就绪的是监听套接字，则说明有新连接到来
-            if(socket.GetFd() == lst_socket.GetFd())
+            if(conn == &listener)
             {
                 TcpSocket new_socket;
-                lst_socket.Accept(&new_socket);
-                epoll.Add(new_socket);
+                if(!lst_socket.Accept(&new_socket))
+                {
+                    continue;
+                }
+
+                Connection* new_conn = new Connection(new_socket.GetFd());
+                epoll.Add(new_conn->GetFd(), new_conn);
             }
             //如果不是，则说明已连接的套接字有新数据到来
             else
             {   
                 string data;
                 //接收数据
-                ret = socket.Recv(data);
+                bool ret = conn->GetSocket().Recv(data);
 
                 //断开连接，移除监控
                 if(ret == false)
                 {   
-                    epoll.Del(socket);
-                    socket.Close();
+                    epoll.Del(conn->GetFd());
+                    conn->Close();
+                    delete conn;
                     continue;
                 }   
 
                 cout << "cli send message: " << data << endl;
-                data.clear();
-
-                if(ret == false)
-                {   
-                    epoll.Del(socket);
-                    socket.Close();
-                    continue;
-                }   
 			}
         }
 	}
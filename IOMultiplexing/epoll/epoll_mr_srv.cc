@@ -0,0 +1,88 @@
+#include<vector>
+#include<pthread.h>
+#include<sys/socket.h>
+#include"TcpSocket.hpp"
+#include"epoll.hpp"
+#include"connection.hpp"
+#include"echo_loop.hpp"
+
+using namespace std;
+
+const int DEFAULT_REACTOR = 4;
+
+//每个reactor线程的启动参数
+struct reactor_arg
+{
+	int id;
+	string ip;
+	uint16_t port;
+	int spin_us;    //自适应等待的空转上限，为0时不空转
+};
+
+//每个线程独占一个监听套接字和一个epoll，线程之间不共享任何状态，也就不需要加锁
+void* reactor_work(void* arg)
+{
+	reactor_arg* rarg = (reactor_arg*)arg;
+
+	TcpSocket lst_socket;
+	//创建监听套接字
+	CheckSafe(lst_socket.Socket());
+	//开启端口复用，所有线程的监听套接字绑定同一个端口，由内核分发新连接
+	CheckSafe(lst_socket.SetReuseport());
+	//绑定地址信息
+	CheckSafe(lst_socket.Bind(rarg->ip, rarg->port));
+	//开始监听
+	CheckSafe(lst_socket.Listen());
+	//每个reactor运行同一个事件循环，日志中带上reactor编号
+	run_echo_loop(lst_socket, rarg->spin_us, "reactor[" + to_string(rarg->id) + "] ");
+
+	lst_socket.Close();
+	return nullptr;
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 3 || argc > 5)
+	{   
+		cerr << "正确输入方式: ./epoll_mr_srv ip port [reactor_num] [spin_us]\n" << endl;
+		return -1; 
+	} 
+
+	string srv_ip = argv[1];
+	uint16_t srv_port = stoi(argv[2]);
+	int reactor_num = (argc >= 4) ? stoi(argv[3]) : DEFAULT_REACTOR;
+	//延迟敏感的部署在独占核心上开启自适应等待
+	int spin_us = (argc == 5) ? stoi(argv[4]) : 0;
+
+	if(reactor_num <= 0)
+	{
+		cerr << "reactor_num must be positive" << endl;
+		return -1;
+	}
+
+	vector<reactor_arg> args(reactor_num);
+	vector<pthread_t> tids(reactor_num);
+
+	//每个线程运行一个独立的reactor
+	for(int i = 0; i < reactor_num; i++)
+	{
+		args[i].id = i;
+		args[i].ip = srv_ip;
+		args[i].port = srv_port;
+		args[i].spin_us = spin_us;
+
+		int res = pthread_create(&tids[i], NULL, reactor_work, &args[i]);
+		if(res != 0)
+		{
+			cerr << "线程创建失败" << endl;
+			return -1;
+		}
+	}
+
+	for(int i = 0; i < reactor_num; i++)
+	{
+		pthread_join(tids[i], NULL);
+	}
+
+	return 0;
+}
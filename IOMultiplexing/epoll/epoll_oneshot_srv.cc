@@ -0,0 +1,183 @@
+#include<queue>
+#include<vector>
+#include<pthread.h>
+#include<sys/socket.h>
+#include"TcpSocket.hpp"
+#include"epoll.hpp"
+#include"connection.hpp"
+
+using namespace std;
+
+const int DEFAULT_WORKER = 4;
+const int ACCEPT_BATCH = 64;    //每轮最多接收的新连接数
+
+//交给工作线程处理的就绪连接
+struct task
+{
+	Connection* conn;
+	uint32_t events;
+};
+
+static queue<task> task_queue;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+
+void push_task(Connection* conn, uint32_t events)
+{
+	pthread_mutex_lock(&queue_mutex);
+	task_queue.push(task{conn, events});
+	pthread_mutex_unlock(&queue_mutex);
+	pthread_cond_signal(&queue_cond);
+}
+
+task pop_task()
+{
+	pthread_mutex_lock(&queue_mutex);
+	while(task_queue.empty())
+	{
+		pthread_cond_wait(&queue_cond, &queue_mutex);
+	}
+	task t = task_queue.front();
+	task_queue.pop();
+	pthread_mutex_unlock(&queue_mutex);
+
+	return t;
+}
+
+//工作线程，连接以EPOLLONESHOT注册，所以同一时刻只有一个线程在处理某个连接，处理完后再重新激活
+void* worker_work(void* arg)
+{
+	long id = (long)arg;
+
+	while(1)
+	{
+		task t = pop_task();
+		Connection* conn = t.conn;
+
+		//可写事件就绪，发送输出缓冲区中积压的数据
+		if(t.events & EPOLLOUT)
+		{
+			if(!conn->HandleWrite())
+			{
+				conn->Close();
+				delete conn;
+				continue;
+			}
+		}
+
+		if(t.events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+		{
+			//接收数据
+			bool ret = conn->HandleRead();
+			Buffer& input = conn->GetInputBuffer();
+
+			//断开连接，移除监控
+			if(!ret)
+			{
+				conn->Close();
+				delete conn;
+				continue;
+			}
+
+			cout << "worker[" << id << "] cli send message: ";
+			cout.write(input.Peek(), input.ReadableBytes()) << endl;
+
+			//回显数据，发送不完的部分由连接缓存，等待可写事件再发送
+			ret = conn->Send(input.Peek(), input.ReadableBytes());
+			input.RetrieveAll();
+			if(!ret)
+			{
+				conn->Close();
+				delete conn;
+				continue;
+			}
+		}
+
+		//处理完毕，重新激活监控，此后reactor才会再次分发该连接
+		conn->Rearm();
+	}
+
+	return nullptr;
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc != 3 && argc != 4)
+	{   
+		cerr << "正确输入方式: ./epoll_oneshot_srv ip port [worker_num]\n" << endl;
+		return -1; 
+	} 
+
+	string srv_ip = argv[1];
+	uint16_t srv_port = stoi(argv[2]);
+	int worker_num = (argc == 4) ? stoi(argv[3]) : DEFAULT_WORKER;
+
+	if(worker_num <= 0)
+	{
+		cerr << "worker_num must be positive" << endl;
+		return -1;
+	}
+
+	TcpSocket lst_socket;
+	//创建监听套接字
+	CheckSafe(lst_socket.Socket());
+	//绑定地址信息
+	CheckSafe(lst_socket.Bind(srv_ip, srv_port));
+	//开始监听
+	CheckSafe(lst_socket.Listen());
+	lst_socket.SetNoBlock();
+
+	//创建工作线程
+	for(long i = 0; i < worker_num; i++)
+	{
+		pthread_t tid;
+		int res = pthread_create(&tid, NULL, worker_work, (void*)i);
+		if(res != 0)
+		{
+			cerr << "线程创建失败" << endl;
+			return -1;
+		}
+		pthread_detach(tid);
+	}
+
+	Epoll epoll;
+	//监听套接字由reactor自己处理，不需要EPOLLONESHOT
+	Connection listener(lst_socket.GetFd());
+	listener.Register(&epoll);
+
+	while(1)
+	{
+		int ret = epoll.Wait();
+		if(ret <= 0)
+		{
+			continue;
+		}
+
+		for(int i = 0; i < ret; i++)
+		{
+			Connection* conn = (Connection*)epoll.GetPtr(i);
+
+			//如果就绪的是监听套接字，则说明有新连接到来
+			if(conn == &listener)
+			{
+				int fds[ACCEPT_BATCH];
+				int count = lst_socket.AcceptBatch(fds, ACCEPT_BATCH);
+
+				//新连接以EPOLLONESHOT方式注册
+				for(int j = 0; j < count; j++)
+				{
+					Connection* new_conn = new Connection(fds[j]);
+					new_conn->Register(&epoll, EPOLLIN | EPOLLET | EPOLLONESHOT);
+				}
+			}
+			//已连接套接字就绪，交给工作线程处理，在其重新激活之前epoll不会再报告该连接
+			else
+			{
+				push_task(conn, epoll.GetEvents(i));
+			}
+		}
+	}
+
+	lst_socket.Close();
+	return 0;
+}
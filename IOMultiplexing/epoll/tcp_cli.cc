@@ -33,7 +33,7 @@ int main(int argc, char* argv[])
 		}
 
 		//发送数据
-		CheckSafe(socket.SendNoBlock(data));
+		CheckSafe(socket.SendAll(data));
 		data.clear();
 	}
 
@@ -0,0 +1,387 @@
+#ifndef __URING_H_
+#define __URING_H_
+
+#include<iostream>
+#include<cstring>
+#include<cstdlib>
+#include<errno.h>
+#include<stdint.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/socket.h>
+#include<sys/syscall.h>
+#include<linux/io_uring.h>
+
+const unsigned URING_ENTRIES = 4096;        //提交队列长度
+const int URING_BATCH = 1000;               //每次最多取出的完成事件数
+const unsigned URING_BUF_COUNT = 4096;      //提供给内核的接收缓冲区个数，必须是2的幂
+const unsigned URING_BUF_SIZE = 4096;       //每个接收缓冲区的大小
+const uint16_t URING_BUF_GROUP = 0;         //接收缓冲区组号
+
+//完成事件对应的操作类型，保存在user_data的低3位中，上下文指针至少8字节对齐所以不会冲突
+enum UringOp
+{
+    URING_ACCEPT = 1,
+    URING_RECV = 2,
+    URING_SEND = 3,
+    URING_CANCEL = 4
+};
+
+const uint64_t URING_OP_MASK = 7;
+
+static inline int sys_io_uring_setup(unsigned entries, struct io_uring_params* p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static inline int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+//基于io_uring的事件引擎，接口形式与Epoll保持一致：Add注册，Del取消，Wait取回就绪事件
+//与epoll不同的是它返回的是完成事件，数据已经由内核读入提供的缓冲区中，不需要再为每个连接单独调用recv
+//  监听套接字使用multishot accept，一次提交持续产生新连接
+//  连接使用multishot recv，配合内核缓冲区环，一次提交持续接收数据
+//  所有请求都先放进提交队列，在Wait中与收割完成事件合并成一次io_uring_enter批量提交
+class Uring
+{
+    public:
+        Uring(unsigned entries = URING_ENTRIES)
+            : _buf_ring(nullptr)
+            , _buf_ring_tail(nullptr)
+            , _buf_base(nullptr)
+            , _ready_count(0)
+        {
+            struct io_uring_params params;
+            memset(&params, 0, sizeof(params));
+
+            _ring_fd = sys_io_uring_setup(entries, &params);
+            if(_ring_fd < 0)
+            {
+                std::cerr << "io_uring setup error" << std::endl;
+                exit(0);
+            }
+
+            //Wait的超时依赖EXT_ARG，内核过老时直接退出
+            if(!(params.features & IORING_FEAT_EXT_ARG))
+            {
+                std::cerr << "io_uring ext arg not supported" << std::endl;
+                exit(0);
+            }
+
+            //映射提交队列和完成队列，新内核中两者共用一次映射
+            _sq_ring_sz = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            _cq_ring_sz = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+            bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+            if(single_mmap && _cq_ring_sz > _sq_ring_sz)
+            {
+                _sq_ring_sz = _cq_ring_sz;
+            }
+
+            _sq_ptr = Map(_sq_ring_sz, IORING_OFF_SQ_RING);
+            _cq_ptr = single_mmap ? _sq_ptr : Map(_cq_ring_sz, IORING_OFF_CQ_RING);
+
+            _sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+            _sqes = (struct io_uring_sqe*)Map(_sqes_sz, IORING_OFF_SQES);
+
+            char* sq = (char*)_sq_ptr;
+            _sq_head = (unsigned*)(sq + params.sq_off.head);
+            _sq_tail = (unsigned*)(sq + params.sq_off.tail);
+            _sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+            _sq_entries = *(unsigned*)(sq + params.sq_off.ring_entries);
+            _sq_array = (unsigned*)(sq + params.sq_off.array);
+            _sq_local_tail = *_sq_tail;
+
+            char* cq = (char*)_cq_ptr;
+            _cq_head = (unsigned*)(cq + params.cq_off.head);
+            _cq_tail = (unsigned*)(cq + params.cq_off.tail);
+            _cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+            _cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+            SetupBufRing();
+        }
+
+        ~Uring()
+        {
+            munmap(_buf_ring, URING_BUF_COUNT * sizeof(struct io_uring_buf));
+            delete[] _buf_base;
+
+            munmap(_sqes, _sqes_sz);
+            if(_cq_ptr != _sq_ptr)
+            {
+                munmap(_cq_ptr, _cq_ring_sz);
+            }
+            munmap(_sq_ptr, _sq_ring_sz);
+            close(_ring_fd);
+        }
+
+        //防拷贝
+        Uring(const Uring&) = delete;
+        Uring& operator=(const Uring&) = delete;
+
+        //对监听套接字发起multishot accept，每到来一个连接产生一个完成事件，结果为新连接的描述符
+        bool AddAccept(int fd, void* ptr)
+        {
+            struct io_uring_sqe* sqe = GetSqe();
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->fd = fd;
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            sqe->accept_flags = SOCK_CLOEXEC;
+            sqe->user_data = Pack(ptr, URING_ACCEPT);
+
+            return true;
+        }
+
+        //对连接发起multishot recv，数据由内核放入缓冲区环中，通过GetBuffer取出，用完后调用RecycleBuffer归还
+        bool AddRecv(int fd, void* ptr)
+        {
+            struct io_uring_sqe* sqe = GetSqe();
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = fd;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = URING_BUF_GROUP;
+            sqe->user_data = Pack(ptr, URING_RECV);
+
+            return true;
+        }
+
+        //发起发送请求，完成事件返回之前data指向的内存必须保持有效
+        bool AddSend(int fd, const char* data, size_t len, void* ptr)
+        {
+            struct io_uring_sqe* sqe = GetSqe();
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = fd;
+            sqe->addr = (uint64_t)data;
+            sqe->len = len;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = Pack(ptr, URING_SEND);
+
+            return true;
+        }
+
+        //取消该描述符上所有未完成的请求，被取消的请求仍然会各自产生一个完成事件
+        bool Del(int fd, void* ptr)
+        {
+            struct io_uring_sqe* sqe = GetSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = fd;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = Pack(ptr, URING_CANCEL);
+
+            return true;
+        }
+
+        //提交所有积压的请求并等待完成事件，一次系统调用同时完成提交和收割
+        //返回取出的完成事件数量，出错返回-1，超时返回0
+        int Wait(int timeout = 3000)
+        {
+            _ready_count = 0;
+
+            //完成队列中已经有事件时不需要阻塞
+            unsigned min_complete = (CompletionCount() > 0) ? 0 : 1;
+            unsigned to_submit = FlushSq();
+
+            struct __kernel_timespec ts;
+            struct io_uring_getevents_arg arg;
+            memset(&arg, 0, sizeof(arg));
+            if(timeout >= 0)
+            {
+                ts.tv_sec = timeout / 1000;
+                ts.tv_nsec = (timeout % 1000) * 1000000LL;
+                arg.ts = (uint64_t)&ts;
+            }
+
+            int ret = sys_io_uring_enter(_ring_fd, to_submit, min_complete, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+            if(ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY)
+            {
+                std::cerr << "io_uring enter error" << std::endl;
+                return -1;
+            }
+
+            //将完成事件拷贝出来后立即归还完成队列的空间，处理事件时可以继续提交新请求
+            unsigned head = *_cq_head;
+            unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+            while(head != tail && _ready_count < URING_BATCH)
+            {
+                _ready[_ready_count++] = _cqes[head & _cq_mask];
+                ++head;
+            }
+            __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+
+            return _ready_count;
+        }
+
+        //获取第i个完成事件注册时的上下文指针
+        void* GetPtr(int i) const
+        {
+            return (void*)(_ready[i].user_data & ~URING_OP_MASK);
+        }
+
+        //获取第i个完成事件的操作类型
+        UringOp GetOp(int i) const
+        {
+            return (UringOp)(_ready[i].user_data & URING_OP_MASK);
+        }
+
+        //获取第i个完成事件的结果，含义与对应系统调用的返回值相同，出错时为负的错误码
+        int GetResult(int i) const
+        {
+            return _ready[i].res;
+        }
+
+        //multishot请求是否仍然有效，为false时需要重新提交
+        bool HasMore(int i) const
+        {
+            return _ready[i].flags & IORING_CQE_F_MORE;
+        }
+
+        //获取第i个recv完成事件的数据所在的缓冲区，没有使用缓冲区时返回nullptr
+        const char* GetBuffer(int i, uint16_t* bid) const
+        {
+            if(!(_ready[i].flags & IORING_CQE_F_BUFFER))
+            {
+                return nullptr;
+            }
+
+            *bid = _ready[i].flags >> IORING_CQE_BUFFER_SHIFT;
+            return _buf_base + (size_t)*bid * URING_BUF_SIZE;
+        }
+
+        //数据处理完后将缓冲区归还给内核
+        void RecycleBuffer(uint16_t bid)
+        {
+            struct io_uring_buf* buf = &_buf_ring[_buf_tail & (URING_BUF_COUNT - 1)];
+            buf->addr = (uint64_t)(_buf_base + (size_t)bid * URING_BUF_SIZE);
+            buf->len = URING_BUF_SIZE;
+            buf->bid = bid;
+
+            ++_buf_tail;
+            __atomic_store_n(_buf_ring_tail, _buf_tail, __ATOMIC_RELEASE);
+        }
+
+    private:
+        void* Map(size_t size, off_t offset)
+        {
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, offset);
+            if(ptr == MAP_FAILED)
+            {
+                std::cerr << "io_uring mmap error" << std::endl;
+                exit(0);
+            }
+
+            return ptr;
+        }
+
+        //注册内核缓冲区环，multishot recv从这里挑选缓冲区存放数据
+        void SetupBufRing()
+        {
+            size_t ring_size = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+            void* ring = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(ring == MAP_FAILED)
+            {
+                std::cerr << "buffer ring mmap error" << std::endl;
+                exit(0);
+            }
+            //先将缓冲区全部放入环中再注册，注册时内核会固定这些内存页
+            memset(ring, 0, ring_size);
+            //C++中内核头文件里io_uring_buf_ring的柔性数组会被空结构体挤到偏移8的位置，所以这里直接按io_uring_buf数组访问
+            //环的尾指针与第一个元素的resv字段重叠
+            _buf_ring = (struct io_uring_buf*)ring;
+            _buf_ring_tail = &_buf_ring[0].resv;
+            _buf_tail = 0;
+            _buf_base = new char[(size_t)URING_BUF_COUNT * URING_BUF_SIZE];
+            for(unsigned i = 0; i < URING_BUF_COUNT; i++)
+            {
+                RecycleBuffer(i);
+            }
+
+            struct io_uring_buf_reg reg;
+            memset(&reg, 0, sizeof(reg));
+            reg.ring_addr = (uint64_t)ring;
+            reg.ring_entries = URING_BUF_COUNT;
+            reg.bgid = URING_BUF_GROUP;
+
+            if(sys_io_uring_register(_ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+            {
+                std::cerr << "io_uring register buffer ring error" << std::endl;
+                exit(0);
+            }
+        }
+
+        static uint64_t Pack(void* ptr, UringOp op)
+        {
+            return (uint64_t)ptr | op;
+        }
+
+        //完成队列中尚未取出的事件数
+        unsigned CompletionCount() const
+        {
+            return __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE) - *_cq_head;
+        }
+
+        //获取一个空闲的提交队列项，队列满时先提交一次
+        struct io_uring_sqe* GetSqe()
+        {
+            if(_sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) >= _sq_entries)
+            {
+                sys_io_uring_enter(_ring_fd, FlushSq(), 0, 0, nullptr, 0);
+            }
+
+            unsigned index = _sq_local_tail & _sq_mask;
+            struct io_uring_sqe* sqe = &_sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            _sq_array[index] = index;
+            ++_sq_local_tail;
+
+            return sqe;
+        }
+
+        //将本地积压的请求发布给内核，返回内核尚未取走的请求数量
+        unsigned FlushSq()
+        {
+            __atomic_store_n(_sq_tail, _sq_local_tail, __ATOMIC_RELEASE);
+
+            return _sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+        }
+
+        int _ring_fd;
+
+        //提交队列
+        void* _sq_ptr;
+        size_t _sq_ring_sz;
+        unsigned* _sq_head;
+        unsigned* _sq_tail;
+        unsigned _sq_mask;
+        unsigned _sq_entries;
+        unsigned* _sq_array;
+        unsigned _sq_local_tail;    //本地尾指针，Wait时才统一发布给内核
+        struct io_uring_sqe* _sqes;
+        size_t _sqes_sz;
+
+        //完成队列
+        void* _cq_ptr;
+        size_t _cq_ring_sz;
+        unsigned* _cq_head;
+        unsigned* _cq_tail;
+        unsigned _cq_mask;
+        struct io_uring_cqe* _cqes;
+
+        //内核缓冲区环
+        struct io_uring_buf* _buf_ring;
+        uint16_t* _buf_ring_tail;
+        char* _buf_base;
+        uint16_t _buf_tail;
+
+        //本轮取出的完成事件
+        struct io_uring_cqe _ready[URING_BATCH];
+        int _ready_count;
+};
+
+#endif
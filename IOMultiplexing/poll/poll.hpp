@@ -0,0 +1,160 @@
+#ifndef __POLL_H_
+#define __POLL_H_
+
+#include<iostream>
+#include<vector>
+#include<poll.h>
+#include<errno.h>
+#include"TcpSocket.hpp"
+
+class Poll
+{
+    public:
+        Poll()
+        {}
+
+        //增加新的监控事件，描述符追加到数组尾部，数组中不会出现空洞
+        bool Add(const TcpSocket& socket, short events = POLLIN)
+        {
+            return Add(socket.GetFd(), events);
+        }
+
+        bool Add(int fd, short events = POLLIN)
+        {
+            if(fd < 0)
+            {
+                return false;
+            }
+
+            //描述符到数组下标的映射，按描述符大小扩容
+            if(fd >= (int)_index.size())
+            {
+                _index.resize(fd + 1, -1);
+            }
+
+            if(_index[fd] != -1)
+            {
+                std::cerr << "poll add repeated fd" << std::endl;
+                return false;
+            }
+
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = events;
+            pfd.revents = 0;
+
+            _index[fd] = _fds.size();
+            _fds.push_back(pfd);
+
+            return true;
+        }
+
+        //修改监控事件
+        bool Mod(int fd, short events)
+        {
+            int i = Find(fd);
+            if(i < 0)
+            {
+                return false;
+            }
+
+            _fds[i].events = events;
+            return true;
+        }
+
+        //删除监控事件，用数组最后一个元素填补被删除的位置，保持数组紧凑
+        bool Del(const TcpSocket& socket)
+        {
+            return Del(socket.GetFd());
+        }
+
+        bool Del(int fd)
+        {
+            int i = Find(fd);
+            if(i < 0)
+            {
+                return false;
+            }
+
+            int last = _fds.size() - 1;
+            if(i != last)
+            {
+                _fds[i] = _fds[last];
+                _index[_fds[i].fd] = i;
+            }
+
+            _fds.pop_back();
+            _index[fd] = -1;
+
+            return true;
+        }
+
+        //开始监控，就绪描述符及其事件保存在成员数组中，返回就绪描述符数量，出错返回-1，超时返回0
+        //就绪数组与监控数组分开保存，处理就绪事件时调用Del不会影响遍历
+        int Wait(int timeout = 2000)
+        {
+            _ready.clear();
+
+            int ret = poll(_fds.data(), _fds.size(), timeout);
+
+            if(ret < 0)
+            {
+                if(errno == EINTR)
+                {
+                    return 0;
+                }
+                std::cerr << "poll error" << std::endl;
+                return -1;
+            }
+
+            //数组是紧凑的，找够ret个就绪描述符就可以提前结束
+            for(size_t i = 0; i < _fds.size() && (int)_ready.size() < ret; i++)
+            {
+                if(_fds[i].revents != 0)
+                {
+                    _ready.push_back(_fds[i]);
+                }
+            }
+
+            return _ready.size();
+        }
+
+        //获取第i个就绪描述符
+        int GetFd(int i) const
+        {
+            return _ready[i].fd;
+        }
+
+        //获取第i个就绪描述符的就绪事件
+        short GetEvents(int i) const
+        {
+            return _ready[i].revents;
+        }
+
+        //当前监控的描述符数量
+        size_t Size() const
+        {
+            return _fds.size();
+        }
+
+    private:
+        //查找描述符在监控数组中的下标，不存在返回-1
+        int Find(int fd) const
+        {
+            if(fd < 0 || fd >= (int)_index.size())
+            {
+                return -1;
+            }
+
+            return _index[fd];
+        }
+
+        //紧凑的监控数组，直接传给poll
+        std::vector<struct pollfd> _fds;
+        //描述符到监控数组下标的映射，不在监控中的描述符为-1
+        std::vector<int> _index;
+        //就绪描述符数组，由Wait填充
+        std::vector<struct pollfd> _ready;
+};
+
+#endif
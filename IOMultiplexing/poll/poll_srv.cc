@@ -2,7 +2,7 @@
 #include<vector>
 #include <sys/socket.h>
 #include"TcpSocket.hpp"
-#define MAX_SIZE 10
+#include"poll.hpp"
 
 using namespace std;
 
@@ -12,7 +12,7 @@ int main(int argc, char* argv[])
 {
 	if(argc != 3)
 	{   
-		cerr << "正确输入方式: ./select_srv.cc ip port\n" << endl;
+		cerr << "正确输入方式: ./poll_srv ip port\n" << endl;
 		return -1; 
 	} 
 
@@ -27,101 +27,63 @@ int main(int argc, char* argv[])
 	//开始监听
 	CheckSafe(lst_socket.Listen());
 
-	struct pollfd poll_fd[MAX_SIZE];
-
-	poll_fd[0].fd = lst_socket.GetFd();
-	poll_fd[0].events = POLLIN;
-
-	int i = 0, maxi = 0;
-	for(i = 1; i < MAX_SIZE; i++)
-	{
-		poll_fd[i].fd = -1;
-	}
+	Poll p;
+	p.Add(lst_socket);
 
 	while(1)
 	{
-		int ret = poll(poll_fd, maxi + 1, 2000);
-        
-        if(ret < 0)
-        {
-            cerr << "not ready" << endl;
-            continue;
-        }
-        else if(ret == 0)
-        {
-            cerr << "wait timeout" << endl;
-            continue;
-        }
-        
-
-		//监听套接字就绪则增加新连接
-		if(poll_fd[0].revents & (POLLIN | POLLERR))
+		//就绪描述符保存在p内部的数组中，数组紧凑，不需要跳过空洞
+		int num = p.Wait();
+
+		for(int i = 0; i < num; i++)
 		{
-			struct sockaddr_in addr;
-			socklen_t len = sizeof(sockaddr_in);
-			//创建一个新的套接字与客户端建立连接
-			int new_fd = accept(lst_socket.GetFd(), (sockaddr*)&addr, &len);
-		    
-			for(i = 1; i < MAX_SIZE; i++)
+			int fd = p.GetFd(i);
+			if(!(p.GetEvents(i) & (POLLIN | POLLERR | POLLHUP)))
 			{
-				if(poll_fd[i].fd == -1)
-				{
-					poll_fd[i].fd = new_fd;
-					poll_fd[i].events = POLLIN;
-                    break;
-				}
+				continue;
 			}
 
-			if(i > maxi)
+			//监听套接字就绪则增加新连接
+			if(fd == lst_socket.GetFd())
 			{
-				maxi = i;
-			}
+				struct sockaddr_in addr;
+				socklen_t len = sizeof(sockaddr_in);
+				//创建一个新的套接字与客户端建立连接
+				int new_fd = accept(lst_socket.GetFd(), (sockaddr*)&addr, &len);
 
-			if(--ret <= 0)
-			{
+				if(new_fd < 0)
+				{
+					cerr << "accept error" << endl;
+					continue;
+				}
+
+				p.Add(new_fd);
 				continue;
 			}
-		}
 
-		for(i = 1; i <= maxi; i++)
-		{   
-			if(poll_fd[i].fd == -1)
+			//新数据到来
+			char buff[4096] = { 0 };
+			int ret = recv(fd, buff, 4095, 0);
+
+			if(ret == 0)
 			{
-				continue;
+				std::cerr << "connect error" << std::endl;
+
+				p.Del(fd);
+				close(fd);
 			}
+			else if(ret < 0)
+			{
+				std::cerr << "recv error" << std::endl;
 
-			if(poll_fd[i].revents & (POLLIN | POLLERR))
+				p.Del(fd);
+				close(fd);
+			}
+			else
 			{
-				//新数据到来
-				char buff[4096] = { 0 };
-				int ret = recv(poll_fd[i].fd, buff, 4096, 0); 
-
-				if(ret == 0)
-				{   
-					std::cerr << "connect error" << std::endl;
-
-					close(poll_fd[i].fd);
-					poll_fd[i].fd = -1;
-				}   
-				else if(ret < 0)
-				{   
-					std::cerr << "recv error" << std::endl;
-					close(poll_fd[i].fd);
-					poll_fd[i].fd = -1;
-				} 
-                else
-                {
-				    cout << "cli send message: " << buff << endl;
-                }
-				
-				if(--ret <= 0)
-				{
-					break;
-				}
+				cout << "cli send message: " << buff << endl;
 			}
 		}
-
-
 	}
 	lst_socket.Close();
 	return 0;
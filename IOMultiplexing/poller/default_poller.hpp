@@ -0,0 +1,37 @@
+#ifndef __DEFAULT_POLLER_H_
+#define __DEFAULT_POLLER_H_
+
+#include<string>
+#include"poller.hpp"
+#include"select_poller.hpp"
+#include"poll_poller.hpp"
+#include"epoll_poller.hpp"
+
+//后端名称列表，用于命令行提示和基准测试
+const char* const POLLER_NAMES[] = { "select", "poll", "epoll_lt", "epoll_et" };
+const int POLLER_NUM = sizeof(POLLER_NAMES) / sizeof(POLLER_NAMES[0]);
+
+//按名称创建后端，名称不合法时返回nullptr
+inline Poller* NewPoller(const std::string& name)
+{
+    if(name == "select")
+    {
+        return new SelectPoller();
+    }
+    else if(name == "poll")
+    {
+        return new PollPoller();
+    }
+    else if(name == "epoll_lt" || name == "epoll")
+    {
+        return new EpollPoller(false);
+    }
+    else if(name == "epoll_et")
+    {
+        return new EpollPoller(true);
+    }
+
+    return nullptr;
+}
+
+#endif
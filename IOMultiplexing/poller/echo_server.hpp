@@ -0,0 +1,225 @@
+#ifndef __ECHO_SERVER_H_
+#define __ECHO_SERVER_H_
+
+#include<iostream>
+#include<unistd.h>
+#include<errno.h>
+#include<sys/socket.h>
+#include"../epoll/TcpSocket.hpp"
+#include"../epoll/buffer.hpp"
+#include"poller.hpp"
+
+const int ECHO_ACCEPT_BATCH = 64;
+const size_t ECHO_READ_SIZE = 65536;
+
+//回显连接，输出缓冲区保存没能一次写完的数据
+struct EchoConn
+{
+    int fd;
+    bool writing;   //是否正在监控可写事件
+    Buffer output;
+};
+
+//基于Poller的回显服务器，读到EAGAIN或对端关闭、写到EAGAIN为止，因此可以运行在任何后端上，包括边缘触发
+class EchoServer
+{
+    public:
+        //listener需要已经开始监听，由服务器设置为非阻塞
+        EchoServer(Poller* poller, TcpSocket& listener)
+            : _poller(poller)
+            , _listener(listener)
+        {
+            _listener.SetNoBlock();
+        }
+
+        void Run()
+        {
+            //监听套接字用服务器对象自身作为上下文指针，以区分连接
+            if(!_poller->Add(_listener.GetFd(), this, POLLER_READ))
+            {
+                return;
+            }
+
+            while(1)
+            {
+                int num = _poller->Wait(3000);
+                if(num < 0)
+                {
+                    break;
+                }
+
+                for(int i = 0; i < num; i++)
+                {
+                    void* ptr = _poller->GetPtr(i);
+                    if(ptr == this)
+                    {
+                        HandleAccept();
+                        continue;
+                    }
+
+                    EchoConn* conn = (EchoConn*)ptr;
+                    uint32_t events = _poller->GetEvents(i);
+
+                    if((events & (POLLER_READ | POLLER_ERROR)) && !HandleRead(conn))
+                    {
+                        Close(conn);
+                        continue;
+                    }
+
+                    if((events & POLLER_WRITE) && !HandleWrite(conn))
+                    {
+                        Close(conn);
+                    }
+                }
+            }
+        }
+
+    private:
+        //一直取到全连接队列为空，超出后端上限的连接直接关闭
+        void HandleAccept()
+        {
+            int fds[ECHO_ACCEPT_BATCH];
+            int num;
+
+            do
+            {
+                num = _listener.AcceptBatch(fds, ECHO_ACCEPT_BATCH);
+
+                for(int i = 0; i < num; i++)
+                {
+                    EchoConn* conn = new EchoConn;
+                    conn->fd = fds[i];
+                    conn->writing = false;
+
+                    if(!_poller->Add(conn->fd, conn, POLLER_READ))
+                    {
+                        close(conn->fd);
+                        delete conn;
+                    }
+                }
+            } while(num == ECHO_ACCEPT_BATCH);
+        }
+
+        //读到EAGAIN或者0为止，读到的数据立即回显，对端关闭或出错时返回false
+        //没有读满也不能停下，最后的数据和FIN同时到达时边缘触发只通知一次，停下就发现不了对端关闭
+        bool HandleRead(EchoConn* conn)
+        {
+            char buff[ECHO_READ_SIZE];
+
+            while(1)
+            {
+                ssize_t ret = read(conn->fd, buff, sizeof(buff));
+
+                if(ret > 0)
+                {
+                    if(!Send(conn, buff, ret))
+                    {
+                        return false;
+                    }
+                }
+                else if(ret == 0)
+                {
+                    return false;
+                }
+                else if(errno == EINTR)
+                {
+                    continue;
+                }
+                else
+                {
+                    return errno == EAGAIN || errno == EWOULDBLOCK;
+                }
+            }
+        }
+
+        //输出缓冲区为空时直接发送，写不完的部分放入缓冲区并开启可写事件监控
+        bool Send(EchoConn* conn, const char* data, size_t len)
+        {
+            size_t sent = 0;
+
+            if(conn->output.ReadableBytes() == 0)
+            {
+                ssize_t ret = WriteNoBlock(conn->fd, data, len);
+                if(ret < 0)
+                {
+                    return false;
+                }
+                sent = ret;
+            }
+
+            if(sent == len)
+            {
+                return true;
+            }
+
+            conn->output.Append(data + sent, len - sent);
+
+            if(!conn->writing)
+            {
+                conn->writing = true;
+                return _poller->Mod(conn->fd, conn, POLLER_READ | POLLER_WRITE);
+            }
+
+            return true;
+        }
+
+        bool HandleWrite(EchoConn* conn)
+        {
+            Buffer& output = conn->output;
+
+            ssize_t ret = WriteNoBlock(conn->fd, output.Peek(), output.ReadableBytes());
+            if(ret < 0)
+            {
+                return false;
+            }
+            output.Retrieve(ret);
+
+            if(output.ReadableBytes() == 0 && conn->writing)
+            {
+                conn->writing = false;
+                return _poller->Mod(conn->fd, conn, POLLER_READ);
+            }
+
+            return true;
+        }
+
+        //写到EAGAIN为止，返回写入的字节数，出错返回-1
+        static ssize_t WriteNoBlock(int fd, const char* data, size_t len)
+        {
+            size_t pos = 0;
+
+            while(pos < len)
+            {
+                ssize_t ret = send(fd, data + pos, len - pos, MSG_NOSIGNAL);
+
+                if(ret < 0)
+                {
+                    if(errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if(errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        break;
+                    }
+                    return -1;
+                }
+
+                pos += ret;
+            }
+
+            return pos;
+        }
+
+        void Close(EchoConn* conn)
+        {
+            _poller->Del(conn->fd);
+            close(conn->fd);
+            delete conn;
+        }
+
+        Poller* _poller;
+        TcpSocket& _listener;
+};
+
+#endif
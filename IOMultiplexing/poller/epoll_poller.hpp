@@ -0,0 +1,68 @@
+#ifndef __EPOLL_POLLER_H_
+#define __EPOLL_POLLER_H_
+
+#include"poller.hpp"
+#include"../epoll/epoll.hpp"
+
+//epoll后端，在Epoll之上转换事件类型，et为true时所有描述符都以边缘触发方式注册，使用者需要一次读空或写满
+class EpollPoller : public Poller
+{
+    public:
+        EpollPoller(bool et = false)
+            : _et(et)
+        {}
+
+        const char* Name() const
+        {
+            return _et ? "epoll_et" : "epoll_lt";
+        }
+
+        bool Add(int fd, void* ptr, uint32_t events)
+        {
+            return _epoll.Add(fd, ptr, ToEpoll(events));
+        }
+
+        bool Mod(int fd, void* ptr, uint32_t events)
+        {
+            return _epoll.Mod(fd, ptr, ToEpoll(events));
+        }
+
+        bool Del(int fd)
+        {
+            return _epoll.Del(fd);
+        }
+
+        int Wait(int timeout)
+        {
+            _ready.clear();
+
+            int num = _epoll.Wait(timeout);
+            for(int i = 0; i < num; i++)
+            {
+                uint32_t revents = _epoll.GetEvents(i);
+
+                PollerEvent ev;
+                ev.ptr = _epoll.GetPtr(i);
+                ev.events = ((revents & EPOLLIN) ? POLLER_READ : 0)
+                          | ((revents & EPOLLOUT) ? POLLER_WRITE : 0)
+                          | ((revents & (EPOLLERR | EPOLLHUP)) ? POLLER_ERROR : 0);
+                _ready.push_back(ev);
+            }
+
+            return num;
+        }
+
+    private:
+        uint32_t ToEpoll(uint32_t events) const
+        {
+            uint32_t ev = ((events & POLLER_READ) ? (uint32_t)EPOLLIN : (uint32_t)0)
+                        | ((events & POLLER_WRITE) ? (uint32_t)EPOLLOUT : (uint32_t)0);
+
+            return _et ? (ev | EPOLLET) : ev;
+        }
+
+        Epoll _epoll;
+        bool _et;
+};
+
+#endif
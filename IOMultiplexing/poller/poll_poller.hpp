@@ -0,0 +1,86 @@
+#ifndef __POLL_POLLER_H_
+#define __POLL_POLLER_H_
+
+#include<vector>
+#include"poller.hpp"
+#include"../poll/poll.hpp"
+
+//poll后端，在Poll之上增加上下文指针
+class PollPoller : public Poller
+{
+    public:
+        const char* Name() const
+        {
+            return "poll";
+        }
+
+        bool Add(int fd, void* ptr, uint32_t events)
+        {
+            if(!_poll.Add(fd, ToPoll(events)))
+            {
+                return false;
+            }
+
+            if(fd >= (int)_ptrs.size())
+            {
+                _ptrs.resize(fd + 1, nullptr);
+            }
+            _ptrs[fd] = ptr;
+
+            return true;
+        }
+
+        bool Mod(int fd, void* ptr, uint32_t events)
+        {
+            if(!_poll.Mod(fd, ToPoll(events)))
+            {
+                return false;
+            }
+
+            _ptrs[fd] = ptr;
+            return true;
+        }
+
+        bool Del(int fd)
+        {
+            if(!_poll.Del(fd))
+            {
+                return false;
+            }
+
+            _ptrs[fd] = nullptr;
+            return true;
+        }
+
+        int Wait(int timeout)
+        {
+            _ready.clear();
+
+            int num = _poll.Wait(timeout);
+            for(int i = 0; i < num; i++)
+            {
+                short revents = _poll.GetEvents(i);
+
+                PollerEvent ev;
+                ev.ptr = _ptrs[_poll.GetFd(i)];
+                ev.events = ((revents & POLLIN) ? POLLER_READ : 0)
+                          | ((revents & POLLOUT) ? POLLER_WRITE : 0)
+                          | ((revents & (POLLERR | POLLHUP | POLLNVAL)) ? POLLER_ERROR : 0);
+                _ready.push_back(ev);
+            }
+
+            return num;
+        }
+
+    private:
+        static short ToPoll(uint32_t events)
+        {
+            return ((events & POLLER_READ) ? POLLIN : 0) | ((events & POLLER_WRITE) ? POLLOUT : 0);
+        }
+
+        Poll _poll;
+        //描述符到上下文指针的映射
+        std::vector<void*> _ptrs;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef __POLLER_H_
+#define __POLLER_H_
+
+#include<vector>
+#include<stdint.h>
+//select、poll、epoll目录下的TcpSocket.hpp使用同一个头文件保护宏，先包含功能最全的epoll版本，后端包含各自目录的版本时会被跳过
+#include"../epoll/TcpSocket.hpp"
+
+//统一的事件类型，各个后端在内部转换为自己的事件
+const uint32_t POLLER_READ = 0x1;
+const uint32_t POLLER_WRITE = 0x2;
+const uint32_t POLLER_ERROR = 0x4;   //出错或者对端挂断，只会出现在就绪事件中
+
+//就绪事件，ptr为注册时传入的上下文指针
+struct PollerEvent
+{
+    void* ptr;
+    uint32_t events;
+};
+
+//IO复用的统一接口，select、poll、epoll三种后端可以在启动时互相替换
+//用法与Epoll相同：注册时传入上下文指针，Wait之后用GetPtr和GetEvents遍历就绪事件
+class Poller
+{
+    public:
+        virtual ~Poller()
+        {}
+
+        //后端名称
+        virtual const char* Name() const = 0;
+
+        //增加新的监控事件
+        virtual bool Add(int fd, void* ptr, uint32_t events) = 0;
+
+        //修改监控事件
+        virtual bool Mod(int fd, void* ptr, uint32_t events) = 0;
+
+        //删除监控事件
+        virtual bool Del(int fd) = 0;
+
+        //开始监控，timeout以毫秒为单位，返回就绪事件数量，出错返回-1，超时返回0
+        virtual int Wait(int timeout) = 0;
+
+        //后端能够监控的描述符上限，-1表示只受进程描述符数量限制
+        virtual int FdLimit() const
+        {
+            return -1;
+        }
+
+        //获取第i个就绪事件注册时存放的上下文指针
+        void* GetPtr(int i) const
+        {
+            return _ready[i].ptr;
+        }
+
+        //获取第i个就绪事件的事件类型
+        uint32_t GetEvents(int i) const
+        {
+            return _ready[i].events;
+        }
+
+    protected:
+        //就绪事件数组，由各个后端的Wait填充
+        std::vector<PollerEvent> _ready;
+};
+
+#endif
@@ -0,0 +1,338 @@
+#include<iostream>
+#include<iomanip>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<vector>
+#include<algorithm>
+#include<cstring>
+#include<unistd.h>
+#include<signal.h>
+#include<time.h>
+#include<errno.h>
+#include<sys/wait.h>
+#include<sys/resource.h>
+#include<sys/socket.h>
+#include<netinet/tcp.h>
+#include"../epoll/TcpSocket.hpp"
+#include"default_poller.hpp"
+#include"echo_server.hpp"
+
+using namespace std;
+
+//回显基准测试：为每个后端fork一个回显服务器子进程，父进程用epoll驱动N条本地回环连接做乒乓请求
+//每条连接同时只有一个请求在途，统计吞吐量、p50/p99延迟以及服务器进程的CPU占用
+
+const int MSG_SIZE = 64;            //每个请求的字节数
+const int WARMUP_MS = 500;          //预热时间，不计入统计
+const int DEFAULT_SECONDS = 3;      //每组测试的统计时间
+const int DEFAULT_MAX_CONNS = 10000;
+const int CONN_LEVELS[] = { 10, 1000, 10000 };
+
+//客户端连接状态
+struct BenchConn
+{
+    int fd;
+    int recvd;          //本轮已经收到的回显字节数
+    long long sent_us;  //本轮请求的发送时间
+};
+
+//测试结果
+struct BenchResult
+{
+    double qps;
+    double p50_us;
+    double p99_us;
+    double cpu;         //服务器进程CPU占用，1.0表示占满一个核
+};
+
+static long long NowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+//读取进程已经消耗的用户态和内核态CPU时间，单位为微秒
+static long long ProcessCpuUs(pid_t pid)
+{
+    ostringstream path;
+    path << "/proc/" << pid << "/stat";
+
+    ifstream in(path.str());
+    string stat;
+    getline(in, stat);
+
+    //进程名可能包含空格，从最后一个')'之后开始解析，utime和stime分别是第14和第15个字段
+    size_t pos = stat.rfind(')');
+    if(pos == string::npos)
+    {
+        return 0;
+    }
+
+    istringstream fields(stat.substr(pos + 2));
+    string field;
+    long long utime = 0, stime = 0;
+    for(int i = 3; i <= 15 && fields >> field; i++)
+    {
+        if(i == 14)
+        {
+            utime = stoll(field);
+        }
+        else if(i == 15)
+        {
+            stime = stoll(field);
+        }
+    }
+
+    return (utime + stime) * 1000000LL / sysconf(_SC_CLK_TCK);
+}
+
+//提高进程描述符上限，客户端和服务器都在本机，每条连接需要两个描述符
+static void RaiseFdLimit(int conns)
+{
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+
+    rlim_t want = conns * 2 + 256;
+    if(rl.rlim_cur >= want)
+    {
+        return;
+    }
+
+    //硬上限不够时尝试一起提高，需要特权
+    if(rl.rlim_max < want)
+    {
+        struct rlimit hard = { want, want };
+        if(setrlimit(RLIMIT_NOFILE, &hard) == 0)
+        {
+            return;
+        }
+    }
+
+    rl.rlim_cur = min(want, rl.rlim_max);
+    setrlimit(RLIMIT_NOFILE, &rl);
+    cerr << "RLIMIT_NOFILE raised to " << rl.rlim_cur << endl;
+}
+
+static bool SendRequest(BenchConn& conn, const char* msg)
+{
+    conn.recvd = 0;
+    conn.sent_us = NowUs();
+
+    return send(conn.fd, msg, MSG_SIZE, MSG_NOSIGNAL) == MSG_SIZE;
+}
+
+//父进程客户端：建立conns条连接，跑完预热和统计时间后返回结果
+static bool RunClient(uint16_t port, int conns, int seconds, pid_t server, BenchResult* result)
+{
+    vector<BenchConn> clients(conns);
+    EpollPoller poller;
+    char msg[MSG_SIZE];
+    memset(msg, 'x', sizeof(msg));
+
+    for(int i = 0; i < conns; i++)
+    {
+        TcpSocket socket;
+        if(!socket.Socket() || !socket.Connect("127.0.0.1", port))
+        {
+            cerr << "only " << i << " connections established" << endl;
+            for(int j = 0; j < i; j++)
+            {
+                close(clients[j].fd);
+            }
+            return false;
+        }
+
+        int opt = 1;
+        setsockopt(socket.GetFd(), IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        socket.SetNoBlock();
+
+        clients[i].fd = socket.GetFd();
+        poller.Add(clients[i].fd, &clients[i], POLLER_READ);
+    }
+
+    for(int i = 0; i < conns; i++)
+    {
+        SendRequest(clients[i], msg);
+    }
+
+    vector<int> latency;
+    long long start = NowUs();
+    long long measure_start = start + WARMUP_MS * 1000LL;
+    long long end = measure_start + seconds * 1000000LL;
+    long long cpu_start = -1;
+    bool ok = true;
+
+    while(ok)
+    {
+        long long now = NowUs();
+        if(now >= end)
+        {
+            break;
+        }
+        if(cpu_start < 0 && now >= measure_start)
+        {
+            cpu_start = ProcessCpuUs(server);
+            latency.clear();
+        }
+
+        int num = poller.Wait(100);
+        if(num < 0)
+        {
+            ok = false;
+            break;
+        }
+
+        for(int i = 0; i < num; i++)
+        {
+            BenchConn& conn = *(BenchConn*)poller.GetPtr(i);
+            char buff[MSG_SIZE];
+
+            ssize_t ret = recv(conn.fd, buff, MSG_SIZE - conn.recvd, 0);
+            if(ret <= 0)
+            {
+                if(ret < 0 && (errno == EAGAIN || errno == EINTR))
+                {
+                    continue;
+                }
+                cerr << "server closed connection" << endl;
+                ok = false;
+                break;
+            }
+
+            conn.recvd += ret;
+            if(conn.recvd < MSG_SIZE)
+            {
+                continue;
+            }
+
+            latency.push_back(NowUs() - conn.sent_us);
+            if(!SendRequest(conn, msg))
+            {
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    long long cpu_end = ProcessCpuUs(server);
+    long long elapsed = NowUs() - measure_start;
+
+    for(int i = 0; i < conns; i++)
+    {
+        close(clients[i].fd);
+    }
+
+    if(!ok || latency.empty() || elapsed <= 0)
+    {
+        return false;
+    }
+
+    size_t p50 = latency.size() / 2;
+    size_t p99 = latency.size() * 99 / 100;
+    nth_element(latency.begin(), latency.begin() + p50, latency.end());
+    result->p50_us = latency[p50];
+    nth_element(latency.begin(), latency.begin() + p99, latency.end());
+    result->p99_us = latency[p99];
+    result->qps = latency.size() * 1000000.0 / elapsed;
+    result->cpu = (double)(cpu_end - cpu_start) / elapsed;
+
+    return true;
+}
+
+//为一个后端启动服务器子进程并运行一组测试
+static bool RunCase(const string& type, int conns, int seconds, BenchResult* result)
+{
+    TcpSocket listener;
+    uint16_t port = 0;
+    if(!listener.Socket() || !listener.Bind("127.0.0.1", port) || !listener.Listen(SOMAXCONN))
+    {
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(listener.GetFd(), (sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+
+    pid_t pid = fork();
+    if(pid < 0)
+    {
+        cerr << "fork error" << endl;
+        listener.Close();
+        return false;
+    }
+    else if(pid == 0)
+    {
+        Poller* poller = NewPoller(type);
+        EchoServer server(poller, listener);
+        server.Run();
+        exit(0);
+    }
+
+    listener.Close();
+
+    bool ret = RunClient(port, conns, seconds, pid, result);
+
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    return ret;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc > 3)
+    {
+        cerr << "正确输入方式: ./poller_bench [seconds] [max_conns]\n" << endl;
+        return -1;
+    }
+
+    int seconds = (argc >= 2) ? stoi(argv[1]) : DEFAULT_SECONDS;
+    int max_conns = (argc == 3) ? stoi(argv[2]) : DEFAULT_MAX_CONNS;
+
+    RaiseFdLimit(max_conns);
+    signal(SIGPIPE, SIG_IGN);
+
+    cout << left << setw(10) << "backend" << setw(8) << "conns" << setw(12) << "req/s"
+         << setw(10) << "p50(us)" << setw(10) << "p99(us)" << "server cpu" << endl;
+
+    for(int conns : CONN_LEVELS)
+    {
+        if(conns > max_conns)
+        {
+            continue;
+        }
+
+        for(int i = 0; i < POLLER_NUM; i++)
+        {
+            string type = POLLER_NAMES[i];
+            cout << left << setw(10) << type << setw(8) << conns;
+
+            //select的描述符不能超过FD_SETSIZE，服务器还需要监听套接字和标准输入输出
+            Poller* poller = NewPoller(type);
+            int limit = poller->FdLimit();
+            delete poller;
+            if(limit > 0 && conns + 8 > limit)
+            {
+                cout << "skipped (fd limit " << limit << ")" << endl;
+                continue;
+            }
+
+            BenchResult result;
+            if(!RunCase(type, conns, seconds, &result))
+            {
+                cout << "failed" << endl;
+                continue;
+            }
+
+            cout << fixed << setprecision(0) << setw(12) << result.qps
+                 << setw(10) << result.p50_us << setw(10) << result.p99_us
+                 << setprecision(1) << result.cpu * 100 << "%" << endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include<iostream>
+#include<string>
+#include<sys/socket.h>
+#include"../epoll/TcpSocket.hpp"
+#include"default_poller.hpp"
+#include"echo_server.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    if(argc != 3 && argc != 4)
+    {
+        cerr << "正确输入方式: ./poller_srv ip port [select|poll|epoll_lt|epoll_et]\n" << endl;
+        return -1;
+    }
+
+    string srv_ip = argv[1];
+    uint16_t srv_port = stoi(argv[2]);
+    string type = (argc == 4) ? argv[3] : "epoll_lt";
+
+    //启动时选择后端
+    Poller* poller = NewPoller(type);
+    if(poller == nullptr)
+    {
+        cerr << "unknown poller: " << type << endl;
+        return -1;
+    }
+
+    TcpSocket listener;
+    //创建监听套接字
+    CheckSafe(listener.Socket());
+    //绑定地址信息
+    CheckSafe(listener.Bind(srv_ip, srv_port));
+    //开始监听
+    CheckSafe(listener.Listen(SOMAXCONN));
+
+    cout << "poller: " << poller->Name() << endl;
+
+    EchoServer server(poller, listener);
+    server.Run();
+
+    delete poller;
+    listener.Close();
+    return 0;
+}
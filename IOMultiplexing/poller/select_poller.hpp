@@ -0,0 +1,81 @@
+#ifndef __SELECT_POLLER_H_
+#define __SELECT_POLLER_H_
+
+#include<vector>
+#include"poller.hpp"
+#include"../select/select.hpp"
+
+//select后端，在Select之上增加上下文指针，描述符不能超过FD_SETSIZE
+class SelectPoller : public Poller
+{
+    public:
+        SelectPoller()
+            : _ptrs(FD_SETSIZE, nullptr)
+        {}
+
+        const char* Name() const
+        {
+            return "select";
+        }
+
+        int FdLimit() const
+        {
+            return FD_SETSIZE;
+        }
+
+        bool Add(int fd, void* ptr, uint32_t events)
+        {
+            if(!_select.Add(fd, events & POLLER_READ, events & POLLER_WRITE))
+            {
+                return false;
+            }
+
+            _ptrs[fd] = ptr;
+            return true;
+        }
+
+        bool Mod(int fd, void* ptr, uint32_t events)
+        {
+            if(!_select.Mod(fd, events & POLLER_READ, events & POLLER_WRITE))
+            {
+                return false;
+            }
+
+            _ptrs[fd] = ptr;
+            return true;
+        }
+
+        bool Del(int fd)
+        {
+            if(!_select.Del(fd))
+            {
+                return false;
+            }
+
+            _ptrs[fd] = nullptr;
+            return true;
+        }
+
+        int Wait(int timeout)
+        {
+            _ready.clear();
+
+            int num = _select.WaitMs(timeout);
+            for(int i = 0; i < num; i++)
+            {
+                PollerEvent ev;
+                ev.ptr = _ptrs[_select.GetFd(i)];
+                ev.events = (_select.Readable(i) ? POLLER_READ : 0) | (_select.Writable(i) ? POLLER_WRITE : 0);
+                _ready.push_back(ev);
+            }
+
+            return num;
+        }
+
+    private:
+        Select _select;
+        //描述符到上下文指针的映射
+        std::vector<void*> _ptrs;
+};
+
+#endif
@@ -3,9 +3,14 @@
 
 #include<iostream>
 #include<vector>
+#include<errno.h>
 #include<sys/socket.h>
+#include<sys/select.h>
 #include"TcpSocket.hpp"
 
+//fd_set底层是unsigned long数组，按字扫描时每个字包含的描述符数量
+const int SELECT_WORD_BITS = sizeof(unsigned long) * 8;
+
 class Select
 {
     public:
@@ -13,36 +18,91 @@ class Select
         {
             //将集合初始化清空
             FD_ZERO(&_rfds);
+            FD_ZERO(&_wfds);
+            FD_ZERO(&_rset);
+            FD_ZERO(&_wset);
         }   
         
         //向集合中添加描述符
         bool Add(const TcpSocket& socket)
         {
-            int fd = socket.GetFd();
-            FD_SET(fd, &_rfds);
+            return Add(socket.GetFd());
+        }
+
+        //按描述符添加，read和write分别表示是否监控可读和可写，描述符不能超过FD_SETSIZE
+        bool Add(int fd, bool read = true, bool write = false)
+        {
+            if(fd < 0 || fd >= FD_SETSIZE)
+            {
+                std::cerr << "select fd out of range" << std::endl;
+                return false;
+            }
 
             if(fd > _maxfd)
             {
                 _maxfd = fd;
             }
 
+            return Mod(fd, read, write);
+        }
+
+        //修改描述符监控的事件
+        bool Mod(int fd, bool read, bool write)
+        {
+            if(fd < 0 || fd >= FD_SETSIZE)
+            {
+                return false;
+            }
+
+            if(read)
+            {
+                FD_SET(fd, &_rfds);
+            }
+            else
+            {
+                FD_CLR(fd, &_rfds);
+            }
+
+            if(write)
+            {
+                FD_SET(fd, &_wfds);
+            }
+            else
+            {
+                FD_CLR(fd, &_wfds);
+            }
+
             return true;
         }
 
         bool Del(const TcpSocket& socket) 
         {
-            int fd = socket.GetFd();
+            return Del(socket.GetFd());
+        }
+
+        bool Del(int fd)
+        {
+            if(fd < 0 || fd >= FD_SETSIZE)
+            {
+                return false;
+            }
+
             FD_CLR(fd, &_rfds);
+            FD_CLR(fd, &_wfds);
 
-            //如果被删除的描述符是最大的，则从后往前再找一个
+            //如果被删除的描述符是最大的，则按字从后往前找第一个非空的字，字内用clz直接定位最高位
             if(fd == _maxfd)
             {
-                for(int i = _maxfd; i >= 0; i--)
+                const unsigned long* rwords = Words(_rfds);
+                const unsigned long* wwords = Words(_wfds);
+                _maxfd = -1;
+
+                for(int w = fd / SELECT_WORD_BITS; w >= 0; w--)
                 {
-                    //如果这个描述符在集合中，则更新最大值
-                    if(FD_ISSET(i, &_rfds))
+                    unsigned long word = rwords[w] | wwords[w];
+                    if(word != 0)
                     {
-                        _maxfd = i;
+                        _maxfd = w * SELECT_WORD_BITS + SELECT_WORD_BITS - 1 - __builtin_clzl(word);
                         break;
                     }
                 }
@@ -61,8 +121,9 @@ class Select
             tv.tv_usec = 0;
             
             //因为select会去掉集合中没就绪的描述符，所以不能直接操作集合，只能操作集合的拷贝
-            fd_set set = _rfds;
-            int ret = select(_maxfd + 1, &set, NULL, NULL, &tv);
+            _rset = _rfds;
+            _wset = _wfds;
+            int ret = select(_maxfd + 1, &_rset, &_wset, NULL, &tv);
 
             if(ret < 0)
             {
@@ -75,26 +136,111 @@ class Select
                 return true;
             }
             
-            for(int i = 0; i < _maxfd + 1; i++)
+            int num = Scan();
+            for(int i = 0; i < num; i++)
             {
                 //将就绪描述符放入数组中
-                if(FD_ISSET(i, &set))
-                {
-                    TcpSocket socket;
-                    socket.SetFd(i);
-                    
-                    vec.push_back(socket);
-                }
+                TcpSocket socket;
+                socket.SetFd(_ready[i]);
+
+                vec.push_back(socket);
             }
 
             return true;
         }   
 
+        //开始监控，就绪描述符保存在成员数组中，返回就绪描述符数量，出错返回-1，超时返回0
+        //配合GetFd直接遍历就绪描述符，每轮循环不再构造任何对象
+        int Wait(int outlime = 3)
+        {
+            return WaitMs(outlime * 1000);
+        }
+
+        //以毫秒为单位的超时，小于0时一直等待
+        int WaitMs(int timeout)
+        {
+            struct timeval tv;
+            tv.tv_sec = timeout / 1000;
+            tv.tv_usec = (timeout % 1000) * 1000;
+
+            _rset = _rfds;
+            _wset = _wfds;
+            int ret = select(_maxfd + 1, &_rset, &_wset, NULL, timeout < 0 ? NULL : &tv);
+
+            if(ret < 0)
+            {
+                if(errno == EINTR)
+                {
+                    return 0;
+                }
+                std::cerr << "select error" << std::endl;
+                return -1;
+            }
+            else if(ret == 0)
+            {
+                return 0;
+            }
+
+            return Scan();
+        }
+
+        //获取第i个就绪描述符
+        int GetFd(int i) const
+        {
+            return _ready[i];
+        }
+
+        //第i个就绪描述符是否可读
+        bool Readable(int i) const
+        {
+            return FD_ISSET(_ready[i], &_rset);
+        }
+
+        //第i个就绪描述符是否可写
+        bool Writable(int i) const
+        {
+            return FD_ISSET(_ready[i], &_wset);
+        }
+
     private:
+        static const unsigned long* Words(const fd_set& set)
+        {
+            return reinterpret_cast<const unsigned long*>(&set);
+        }
+
+        //按字扫描就绪集合，跳过全0的字，非0的字用ctz逐个取出最低位的描述符
+        //扫描代价与就绪描述符数量成正比，而不是与最大描述符成正比，同一个描述符的读写就绪只记录一次
+        int Scan()
+        {
+            const unsigned long* rwords = Words(_rset);
+            const unsigned long* wwords = Words(_wset);
+            int nwords = _maxfd / SELECT_WORD_BITS + 1;
+            int num = 0;
+
+            for(int w = 0; w < nwords; w++)
+            {
+                unsigned long word = rwords[w] | wwords[w];
+                while(word != 0)
+                {
+                    _ready[num++] = w * SELECT_WORD_BITS + __builtin_ctzl(word);
+                    //清除最低位的1
+                    word &= word - 1;
+                }
+            }
+
+            return num;
+        }
+
         //需要监控的描述符，因为select会修改集合，所以每次进行操作的都是它的拷贝
         fd_set _rfds;
+        fd_set _wfds;
+        //上一次select返回的就绪集合
+        fd_set _rset;
+        fd_set _wset;
         //最大的描述符，因为fd_set是位图，所以保存最大的描述符可以减少遍历的次数。
         int _maxfd;
+        //就绪描述符数组，由Scan填充
+        int _ready[FD_SETSIZE];
 };
 
 #endif
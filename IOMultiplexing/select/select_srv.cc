@@ -32,19 +32,16 @@ int main(int argc, char* argv[])
     s.Add(lst_socket);
     while(1)
     {
-        vector<TcpSocket> vec; 
-
-        //去掉未就绪描述符
-        bool ret = s.Wait(vec);
-
-        if(ret == false)
-        {
-            continue;
-        }
+        //去掉未就绪描述符，就绪描述符保存在s内部的数组中
+        int num = s.Wait();
 
         //取出就绪描述符进行处理
-        for(auto socket : vec)
+        for(int i = 0; i < num; i++)
         {
+            TcpSocket socket;
+            socket.SetFd(s.GetFd(i));
+            bool ret;
+
             //如果就绪的是监听套接字，则代表有新连接
             if(socket.GetFd() == lst_socket.GetFd())
             {
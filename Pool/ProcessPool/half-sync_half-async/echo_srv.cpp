@@ -0,0 +1,144 @@
+#include <iostream>
+#include <string>
+#include "process_pool.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static const int BUFFER_SIZE = 4096;
+
+//回显任务，进程池按描述符下标为每个连接保存一个实例
+class EchoConn
+{
+public:
+    //新连接到来时由子进程调用
+    void init(int epoll_fd, int sock_fd, const sockaddr_in& addr)
+    {
+        _epoll_fd = epoll_fd;
+        _sock_fd = sock_fd;
+        _addr = addr;
+
+        //连接以ET模式加入epoll，必须是非阻塞的
+        setnonblocking(_sock_fd);
+    }
+
+    //可读事件就绪时由子进程调用，读到EAGAIN为止并原样发回
+    void process()
+    {
+        char buff[BUFFER_SIZE];
+
+        while(true)
+        {
+            int ret = recv(_sock_fd, buff, sizeof(buff), 0);
+
+            if(ret > 0)
+            {
+                send_all(buff, ret);
+            }
+            else if(ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                break;
+            }
+            else if(ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else
+            {
+                //对端关闭或出错，移除监控并关闭连接
+                epoll_del_fd(_epoll_fd, _sock_fd);
+                break;
+            }
+        }
+    }
+
+private:
+    //回显数据量很小，发送缓冲区写满时短暂等待即可
+    void send_all(const char* data, int len)
+    {
+        int pos = 0;
+        while(pos < len)
+        {
+            int ret = send(_sock_fd, data + pos, len - pos, MSG_NOSIGNAL);
+            if(ret < 0)
+            {
+                if(errno == EAGAIN || errno == EINTR)
+                {
+                    usleep(100);
+                    continue;
+                }
+                return;
+            }
+            pos += ret;
+        }
+    }
+
+    int _epoll_fd;
+    int _sock_fd;
+    sockaddr_in _addr;
+};
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3 || argc > 6)
+    {
+        cerr << "正确输入方式: ./echo_srv ip port [notify|direct|passfd] [process_num] [rr|least|p2c|hash]\n" << endl;
+        return -1;
+    }
+
+    std::string mode = (argc >= 4) ? argv[3] : "notify";
+    int process_num = (argc >= 5) ? atoi(argv[4]) : 4;
+    std::string policy = (argc == 6) ? argv[5] : "rr";
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(listen_fd >= 0);
+
+    int opt = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(atoi(argv[2]));
+    addr.sin_addr.s_addr = inet_addr(argv[1]);
+
+    if(bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0)
+    {
+        cerr << "bind or listen error" << endl;
+        return -1;
+    }
+
+    AcceptMode accept_mode = ACCEPT_NOTIFY;
+    if(mode == "direct")
+    {
+        accept_mode = ACCEPT_DIRECT;
+    }
+    else if(mode == "passfd")
+    {
+        accept_mode = ACCEPT_PASSFD;
+    }
+
+    //父子进程都从这里返回，各自进入自己的主循环
+    ProcessPool<EchoConn>* pool = ProcessPool<EchoConn>::get_instance(listen_fd, process_num, accept_mode);
+
+    //分配策略只在父进程分配连接时生效
+    if(policy == "least")
+    {
+        pool->set_dispatch_policy(DISPATCH_LEAST_ACTIVE);
+    }
+    else if(policy == "p2c")
+    {
+        pool->set_dispatch_policy(DISPATCH_POWER_OF_TWO);
+    }
+    else if(policy == "hash")
+    {
+        pool->set_dispatch_policy(DISPATCH_HASH_ADDR);
+    }
+
+    pool->run();
+    delete pool;
+
+    close(listen_fd);
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <assert.h>
 #include <stdio.h>
@@ -14,18 +15,52 @@
 #include <stdlib.h>
 #include <sys/epoll.h>
 #include <signal.h>
+#include <sched.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <new>
+#include <atomic>
+#include <iostream>
 
 static const int MAX_LISTEN = 10;
 static const int MAX_PROCESS_NUMBER = 16;   //进程池的最大进程数
 static const int USER_PER_PROCESS = 65536;  //子进程所能处理的最大客户量
 static const int MAX_EVENT_NUMBER = 10000;  //epoll最大监听事件数
+static const int PASS_FD_MAX = 253;         //一条消息最多携带的描述符数，即内核的SCM_MAX_FD
+static const int ACCEPT_BATCH = 8;          //ACCEPT_DIRECT模式下子进程每次唤醒最多accept的连接数
 static int sig_pipefd[2];                   //用于统一事件源的信号管道
 
+//新连接的接收方式
+enum AcceptMode
+{
+    ACCEPT_NOTIFY,  //父进程监听新连接，通过管道通知子进程去accept，子进程每次只取走分给自己的连接数
+    ACCEPT_DIRECT,  //子进程以EPOLLEXCLUSIVE方式监控共享的监听套接字并直接accept，父进程只负责监管
+    ACCEPT_PASSFD,  //父进程批量accept，按分配策略选出子进程，通过SCM_RIGHTS把连接连同客户端地址一起传给子进程
+};
+
+//父进程分配新连接的策略，在ACCEPT_NOTIFY和ACCEPT_PASSFD模式下使用
+enum DispatchPolicy
+{
+    DISPATCH_ROUND_ROBIN,   //轮询
+    DISPATCH_LEAST_ACTIVE,  //活跃连接数最少的子进程
+    DISPATCH_POWER_OF_TWO,  //随机选两个子进程，取活跃连接数较少的一个
+    DISPATCH_HASH_ADDR,     //按客户端地址哈希，同一客户端总是落到同一个子进程，需要父进程知道客户端地址(ACCEPT_PASSFD)，否则退化为轮询
+};
+
+//子进程发布的负载信息，放在父子进程共享的内存中，按缓存行对齐，避免不同子进程更新计数时互相干扰
+struct alignas(64) ProcessLoad
+{
+    std::atomic<int> active;    //当前活跃连接数
+    std::atomic<int> notified;  //ACCEPT_NOTIFY模式下父进程已经分给该子进程、但还没有被取走的连接数
+};
+
 //子进程的描述信息
 class Process
 {
+    template<class T>
+    friend class ProcessPool;
+
 public:
     Process()
         : _pid(-1)
@@ -44,12 +79,12 @@ class ProcessPool
 {
 public:
     //获取实例的唯一接口
-    static ProcessPool<T>* get_instance(int listenfd, int process_number = 8)
+    static ProcessPool<T>* get_instance(int listenfd, int process_number = 8, AcceptMode mode = ACCEPT_NOTIFY)
     {
         //懒汉模式，在需要的时候才去创建
         if(_instance == nullptr)
         {
-            _instance = new ProcessPool<T>(listenfd, process_number);
+            _instance = new ProcessPool<T>(listenfd, process_number, mode);
         }
 
         return _instance;
@@ -57,9 +92,16 @@ public:
 
     ~ProcessPool()
     {
+        munmap(_load, sizeof(ProcessLoad) * _size);
         delete[] _process;
     }
 
+    //设置新连接的分配策略，需要在run之前调用
+    void set_dispatch_policy(DispatchPolicy policy)
+    {
+        _policy = policy;
+    }
+
     void run();             //启动进程池
     void setup_sig_pipe();  //统一事件源以及初始化
     void run_parent();      //运行父进程
@@ -67,13 +109,28 @@ public:
 
 private:
     //构造函数私用，用于实现单例模式，确保只有一个进程池
-    ProcessPool(int listenfd, int process_number = 8);
+    ProcessPool(int listenfd, int process_number = 8, AcceptMode mode = ACCEPT_NOTIFY);
+
+    bool spawn(int index);          //创建第index个子进程，父进程中返回true，子进程中返回false
+    int accept_direct(T* user, int max);    //子进程直接从监听套接字取出新连接，最多取max个，返回从队列中取出的个数
+    bool notify_children();         //父进程把全连接队列中新到的连接按分配策略分给子进程，没有存活的子进程时返回false
+    void accept_passfd();           //父进程取出所有新连接，分批传给选中的子进程
+    void recv_passfd(T* user);      //子进程接收父进程传来的所有连接
+    int select_child(const sockaddr_in* addr);  //按分配策略选择一个子进程，没有存活的子进程时返回-1
+    void conn_opened(int connfd);   //子进程接收新连接后更新负载
+    void conn_checked(int connfd);  //子进程处理完连接事件后检查连接是否已经被关闭
 
     int _size;          //进程池中的进程数
     int _id;            //当前进程在池中的序号
     int _epoll_fd;      //epoll操作句柄
     int _listen_fd;     //监听套接字
     bool _stop;         //是否停止运行
+    bool _exiting;      //父进程收到退出信号，不再重新创建退出的子进程
+    AcceptMode _mode;   //新连接的接收方式
+    DispatchPolicy _policy;     //新连接的分配策略
+    int _next;                  //轮询的下一个子进程
+    ProcessLoad* _load;         //所有子进程的负载，父子进程共享
+    bool* _conn_open;           //子进程中每个描述符是否是本进程统计过的活跃连接
     Process* _process;  //所有进程的描述信息
     static ProcessPool<T>* _instance;    //唯一的进程池实例
 };
@@ -100,6 +157,16 @@ static void epoll_add_fd(int epoll_fd, int fd)
     epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
 }
 
+//以EPOLLEXCLUSIVE方式监控多个进程共享的监听套接字，新连接到来时内核只唤醒其中一个进程，避免惊群
+static void epoll_add_fd_exclusive(int epoll_fd, int fd)
+{
+    struct epoll_event event;
+    event.data.fd = fd;
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
 //将描述符从epoll监控集合中移除
 static void epoll_del_fd(int epoll_fd, int fd)
 {
@@ -107,6 +174,99 @@ static void epoll_del_fd(int epoll_fd, int fd)
     close(fd);
 }
 
+//通过socketpair一次发送多个描述符，每个描述符对应的客户端地址作为普通数据一起发送
+//管道必须是SOCK_SEQPACKET类型，保证一条消息中的地址和描述符不会被拆开或者和其他消息粘在一起
+static bool send_fds(int sock_fd, const int* fds, const sockaddr_in* addrs, int n)
+{
+    assert(n > 0 && n <= PASS_FD_MAX);
+
+    //辅助数据缓冲区要按cmsghdr对齐
+    union
+    {
+        cmsghdr align;
+        char buff[CMSG_SPACE(sizeof(int) * PASS_FD_MAX)];
+    } control;
+
+    iovec iov[1];
+    iov[0].iov_base = (void*)addrs;
+    iov[0].iov_len = sizeof(sockaddr_in) * n;
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buff;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * n);
+
+    cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * n);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    memcpy(CMSG_DATA(cm), fds, sizeof(int) * n);
+
+    int ret;
+    do
+    {
+        ret = sendmsg(sock_fd, &msg, MSG_NOSIGNAL);
+    } while(ret < 0 && errno == EINTR);
+
+    return ret == (int)(sizeof(sockaddr_in) * n);
+}
+
+//接收一条消息中的所有描述符和对应的客户端地址，返回对端发送的连接数，没有收到的描述符置为-1
+//对端关闭返回0，出错或者没有消息返回-1
+static int recv_fds(int sock_fd, int* fds, sockaddr_in* addrs, int max)
+{
+    union
+    {
+        cmsghdr align;
+        char buff[CMSG_SPACE(sizeof(int) * PASS_FD_MAX)];
+    } control;
+
+    iovec iov[1];
+    iov[0].iov_base = addrs;
+    iov[0].iov_len = sizeof(sockaddr_in) * max;
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buff;
+    msg.msg_controllen = sizeof(control.buff);
+
+    int ret = recvmsg(sock_fd, &msg, MSG_CMSG_CLOEXEC);
+    if(ret <= 0)
+    {
+        return ret;
+    }
+
+    int n = 0;
+    for(cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+    {
+        if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+        {
+            n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cm), sizeof(int) * n);
+            break;
+        }
+    }
+
+    //子进程描述符耗尽时内核会丢弃放不下的描述符，只能处理实际收到的部分
+    if(msg.msg_flags & MSG_CTRUNC)
+    {
+        std::cout << "recv_fds: control data truncated." << std::endl;
+    }
+
+    //地址和描述符一一对应
+    int addr_num = ret / sizeof(sockaddr_in);
+    for(int i = n; i < addr_num; i++)
+    {
+        fds[i] = -1;
+    }
+
+    return addr_num;
+}
+
 //信号处理函数
 static void sig_handler(int sig)
 {
@@ -120,8 +280,9 @@ static void sig_handler(int sig)
 static void set_sig_handler(int sig)
 {
     struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
     sa.sa_handler = sig_handler;
-    sa.sa_flags |= SA_RESTART;  //重新调用被信号中断的系统函数
+    sa.sa_flags = SA_RESTART;   //重新调用被信号中断的系统函数
     sigfillset(&sa.sa_mask);    //将所有信号加入信号掩码中
 
     if(sigaction(sig, &sa, NULL) < 0)
@@ -131,36 +292,85 @@ static void set_sig_handler(int sig)
 }
 
 template<class T>
-ProcessPool<T>::ProcessPool(int listenfd, int process_number)
+ProcessPool<T>::ProcessPool(int listenfd, int process_number, AcceptMode mode)
+    : _size(process_number)
+    , _id(-1)
+    , _epoll_fd(-1)
+    , _listen_fd(listenfd)
+    , _stop(false)
+    , _exiting(false)
+    , _mode(mode)
+    , _policy(DISPATCH_ROUND_ROBIN)
+    , _next(0)
+    , _conn_open(nullptr)
 {
+    assert(process_number > 0 && process_number <= MAX_PROCESS_NUMBER);
+
     _process = new Process[process_number];
     assert(_process);
 
+    //负载计数放在匿名共享内存中，fork之后父子进程看到的是同一块内存
+    void* mem = mmap(nullptr, sizeof(ProcessLoad) * process_number, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(mem != MAP_FAILED);
+    _load = new (mem) ProcessLoad[process_number];
     for(int i = 0; i < process_number; i++)
     {
-        //建立父子进程的通信管道
-        int ret = socketpair(PF_UNIX, SOCK_STREAM, 0, _process[i]._pipefd);
-        assert(ret != -1);
+        _load[i].active = 0;
+        _load[i].notified = 0;
+    }
 
-        //创建子进程
-        _process[i]._pid = fork();
-        assert(_process[i]._pid != -1);
+    //多个子进程共享同一个监听套接字accept，没抢到连接的进程不能阻塞在accept上
+    setnonblocking(_listen_fd);
 
-        //由于子进程会拷贝父进程的描述符，所以父子进程分别将管道多余的一段关闭
-        if(_process[i]._pid > 0)
+    for(int i = 0; i < process_number; i++)
+    {
+        //子进程创建完后退出循环，防止子进程也创建子进程
+        if(!spawn(i))
         {
-            //父进程关闭后继续继续创建下一个进程
-            close(_process[i]._pipefd[1]);
-            continue;
+            break;
         }
-        else 
+    }
+}
+
+//创建子进程，父进程中返回true，子进程中设置好自己的编号后返回false
+template<class T>
+bool ProcessPool<T>::spawn(int index)
+{
+    //建立父子进程的通信管道，传递描述符时需要保留消息边界
+    int type = (_mode == ACCEPT_PASSFD) ? SOCK_SEQPACKET : SOCK_STREAM;
+    int ret = socketpair(PF_UNIX, type, 0, _process[index]._pipefd);
+    assert(ret != -1);
+
+    //在fork之前清空负载，ACCEPT_PASSFD模式下父进程分配连接时就会计数，不能等子进程运行后再清空
+    _load[index].active = 0;
+    _load[index].notified = 0;
+
+    //创建子进程
+    _process[index]._pid = fork();
+    assert(_process[index]._pid != -1);
+
+    //由于子进程会拷贝父进程的描述符，所以父子进程分别将管道多余的一段关闭
+    if(_process[index]._pid > 0)
+    {
+        //父进程关闭后继续继续创建下一个进程
+        close(_process[index]._pipefd[1]);
+        return true;
+    }
+
+    //子进程关闭后设置自己的进程编号
+    close(_process[index]._pipefd[0]);
+    _id = index;
+
+    //fork时复制了父进程和其他子进程之间的管道，必须关闭，否则父进程关闭管道后对应的子进程读不到关闭，还白白占用描述符
+    //运行中补上的子进程会复制到所有存活兄弟进程的管道
+    for(int m = 0; m < _size; m++)
+    {
+        if(m != index && _process[m]._pid != -1)
         {
-            //子进程关闭后设置自己的进程编号然后退出循环，防止子进程也创建子进程
-            close(_process[i]._pipefd[0]);
-            _id = i;
-            break;
+            close(_process[m]._pipefd[0]);
         }
     }
+    return false;
 }
 
 template<class T>
@@ -177,8 +387,10 @@ void ProcessPool<T>::setup_sig_pipe()
     setnonblocking(sig_pipefd[1]);  //将写端设为非阻塞
     epoll_add_fd(_epoll_fd, sig_pipefd[0]);    //将读端加入epoll监控集合
     
+    set_sig_handler(SIGCHLD);   //子进程退出
     set_sig_handler(SIGALRM);   //设置定时信号
-    set_sig_handler(SIGTERM);   //用户按下中断键（DELETE或者Ctrl+C）
+    set_sig_handler(SIGTERM);   //终止进程
+    set_sig_handler(SIGINT);    //用户按下中断键（DELETE或者Ctrl+C）
 }
 
 template<class T>
@@ -200,12 +412,15 @@ template<class T>
 void ProcessPool<T>::run_parent()
 {
     setup_sig_pipe();   //统一事件源
-    epoll_add_fd(_epoll_fd, _listen_fd);    //将监听套接字加入epoll中
+
+    //直接accept模式下父进程不碰监听套接字，只处理信号
+    if(_mode != ACCEPT_DIRECT)
+    {
+        epoll_add_fd(_epoll_fd, _listen_fd);    //将监听套接字加入epoll中
+    }
 
     epoll_event events[MAX_EVENT_NUMBER];
     int ret, number;
-    int child_count = 0;
-    int new_conn = 1;   //标记新连接到来
 
     while(!_stop)
     {
@@ -222,29 +437,18 @@ void ProcessPool<T>::run_parent()
             int sock_fd = events[i].data.fd;
             
             //如果是监听套接字就绪，则说明有新连接到来
-            if(sock_fd == _listen_fd)
+            if(sock_fd == _listen_fd && _mode == ACCEPT_PASSFD)
+            {
+                accept_passfd();
+            }
+            else if(sock_fd == _listen_fd)
             {
-                int j = child_count;
-                //使用Round Robin算法将新连接轮询分配给子进程
-                do
-                {
-                    if(_process[j]._pid != -1)
-                    {
-                        break;
-                    }
-                    j = (j + 1) % _size;
-                } while (j != child_count);
-                
                 //如果没有子进程在运行，则退出
-                if(_process[j]._pid == -1)
+                if(!notify_children())
                 {
                     _stop = true;
                     break;
-                }   
-
-                child_count = (j + 1) % _size;
-                //通过管道通知子进程接收连接
-                send(_process[j]._pipefd[0], (char*)&new_conn, sizeof(new_conn), 0);
+                }
             }
             //如果信号管道的读端就绪, 则说明当前有信号到来
             else if(sock_fd == sig_pipefd[0] && events[i].events & EPOLLIN)
@@ -279,6 +483,20 @@ void ProcessPool<T>::run_parent()
                                             std::cout << "child : " << pid << " exit." << std::endl;
                                             close(_process[k]._pipefd[0]);
                                             _process[k]._pid = -1;
+                                            //退出的子进程的连接已经全部关闭
+                                            _load[k].active = 0;
+                                            _load[k].notified = 0;
+
+                                            //直接accept模式下子进程之间完全对等，退出的子进程直接补上，不需要父进程做任何分配
+                                            if(_mode == ACCEPT_DIRECT && !_exiting && !spawn(k))
+                                            {
+                                                //新的子进程不需要父进程的epoll和信号管道
+                                                close(_epoll_fd);
+                                                close(sig_pipefd[0]);
+                                                close(sig_pipefd[1]);
+                                                run_child();
+                                                exit(0);
+                                            }
                                             break;
                                         }
                                     }
@@ -300,6 +518,7 @@ void ProcessPool<T>::run_parent()
                             //杀死所有的子进程后退出
                             case SIGINT:
                             {
+                                _exiting = true;
                                 for(int k = 0; k < _size; k++)
                                 {
                                     int pid = _process[k]._pid;
@@ -339,10 +558,24 @@ void ProcessPool<T>::run_child()
     int pipefd = _process[_id]._pipefd[1];
     epoll_add_fd(_epoll_fd, pipefd);
 
+    //管道以ET方式监控，传递描述符时要一直读到没有消息为止
+    if(_mode == ACCEPT_PASSFD)
+    {
+        setnonblocking(pipefd);
+    }
+
+    //直接accept模式下每个子进程都监控共享的监听套接字
+    if(_mode == ACCEPT_DIRECT)
+    {
+        epoll_add_fd_exclusive(_epoll_fd, _listen_fd);
+    }
+
     epoll_event events[MAX_EVENT_NUMBER];
 
-    T* user = new T [MAX_PROCESS_NUMBER];
+    //按描述符下标保存用户数据
+    T* user = new T [USER_PER_PROCESS];
     assert(user);
+    _conn_open = new bool [USER_PER_PROCESS]();
 
     int ret, number;
     while(!_stop)
@@ -359,32 +592,61 @@ void ProcessPool<T>::run_child()
         {
             int sock_fd = events[i].data.fd;
             
+            //父进程直接传来了连接
+            if(sock_fd == pipefd && _mode == ACCEPT_PASSFD)
+            {
+                recv_passfd(user);
+            }
             //如果是父子管道中有数据，则说明是父进程发送的socket到来了
-            if(sock_fd == pipefd && events[i].events & EPOLLIN)
+            else if(sock_fd == pipefd && events[i].events & EPOLLIN)
             {
-                int new_conn = 0;
-                ret = recv(sock_fd, (char*)&new_conn, sizeof(new_conn), 0);
-
-                //如果接收失败，则跳过本回
-                if((( ret < 0 ) && ( errno != EAGAIN ) ) || ret == 0 ) 
+                //管道以ET方式监控，要取走积压的所有通知，每条通知是父进程分给本进程的连接数
+                int total = 0;
+                int new_conn[64];
+                while(true)
                 {
-                    continue;
-                }
-                else
-                {
-                    sockaddr_in addr;
-                    socklen_t len = sizeof(addr);
-
-                    int connfd = accept(_listen_fd, (sockaddr*)&addr, len);
-                    if(connfd < 0)
+                    ret = recv(sock_fd, (char*)new_conn, sizeof(new_conn), MSG_DONTWAIT);
+                    if(ret < 0 && errno == EINTR)
                     {
                         continue;
                     }
-                    epoll_add_fd(_epoll_fd, connfd);
-                    user[connfd].init(_epoll_fd, connfd, addr);
+                    //如果接收失败或者父进程已经关闭管道，则停止接收
+                    if(ret <= 0)
+                    {
+                        break;
+                    }
+
+                    for(int k = 0; k < ret / (int)sizeof(int); k++)
+                    {
+                        total += new_conn[k];
+                    }
+                }
+
+                //只取走分给自己的连接数，剩下的留给其他子进程，否则先被唤醒的子进程会取空整个队列，分配策略形同虚设
+                //先减去计数再accept，父进程统计时宁可多通知一次，也不能漏掉已经在队列中的连接
+                if(total > 0)
+                {
+                    _load[_id].notified -= total;
+                    accept_direct(user, total);
                 }
-                
             } 
+            //直接accept模式下监听套接字就绪，说明有新连接到来
+            else if(sock_fd == _listen_fd && _mode == ACCEPT_DIRECT)
+            {
+                //每次唤醒只取一批，取满说明队列中还有连接，让出CPU给同样被唤醒的其他子进程去取
+                //否则监听套接字一直可读，先运行的子进程会在时间片内取走整个队列
+                if(accept_direct(user, ACCEPT_BATCH) == ACCEPT_BATCH)
+                {
+                    sched_yield();
+                }
+                //队列已经取空，重新注册监听套接字，排到监听套接字等待队列的末尾
+                //EPOLLEXCLUSIVE总是唤醒等待队列中第一个空闲的进程，不轮换的话刚处理完的子进程会一直优先被唤醒
+                else
+                {
+                    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, _listen_fd, nullptr);
+                    epoll_add_fd_exclusive(_epoll_fd, _listen_fd);
+                }
+            }
             //如果信号管道的读端就绪, 则说明当前有信号到来
             else if(sock_fd == sig_pipefd[0] && events[i].events & EPOLLIN)
             {
@@ -432,6 +694,7 @@ void ProcessPool<T>::run_child()
             {
                 //执行用户任务
                 user[sock_fd].process();
+                conn_checked(sock_fd);
             }
             else
             {
@@ -442,9 +705,334 @@ void ProcessPool<T>::run_child()
 
     delete[] user;
     user = nullptr;
+    delete[] _conn_open;
+    _conn_open = nullptr;
 
     close(pipefd);
     close(_epoll_fd);
 }
 
+//最多取出max个连接，其他子进程可能已经取走，EAGAIN属于正常情况
+template<class T>
+int ProcessPool<T>::accept_direct(T* user, int max)
+{
+    int i = 0;
+    for(; i < max; i++)
+    {
+        sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+
+        int connfd = accept4(_listen_fd, (sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(connfd < 0)
+        {
+            if(errno == EINTR)
+            {
+                i--;
+                continue;
+            }
+            //被客户端放弃的连接已经出队，也算作一个
+            if(errno == ECONNABORTED)
+            {
+                continue;
+            }
+            break;
+        }
+
+        //超出单个子进程能处理的最大客户量
+        if(connfd >= USER_PER_PROCESS)
+        {
+            close(connfd);
+            continue;
+        }
+
+        epoll_add_fd(_epoll_fd, connfd);
+        user[connfd].init(_epoll_fd, connfd, addr);
+        conn_opened(connfd);
+    }
+
+    return i;
+}
+
+//父进程以ET方式监控监听套接字，连续到达的多个连接可能只产生一次通知
+//所以从TCP_INFO读出全连接队列的长度，减去已经通知但还没被取走的连接，剩下的才是新连接，逐个按分配策略分配
+//先读队列长度再读计数，子进程又是先减计数再accept，两者交错时只会多通知，不会漏掉连接，多出的通知accept时得到EAGAIN
+template<class T>
+bool ProcessPool<T>::notify_children()
+{
+    int queued = 1;
+    tcp_info info;
+    socklen_t len = sizeof(info);
+    if(getsockopt(_listen_fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0)
+    {
+        //监听套接字的tcpi_unacked是全连接队列中的连接数
+        queued = info.tcpi_unacked;
+    }
+
+    int pending = 0;
+    for(int k = 0; k < _size; k++)
+    {
+        if(_process[k]._pid != -1)
+        {
+            pending += _load[k].notified;
+        }
+    }
+
+    //同一轮分给同一个子进程的连接合并成一条通知
+    int count[MAX_PROCESS_NUMBER] = {0};
+    for(int n = queued - pending; n > 0; n--)
+    {
+        int j = select_child(nullptr);
+        if(j == -1)
+        {
+            return false;
+        }
+
+        //分配时立即计数，同一轮中后面的连接就能看到前面的分配结果
+        _load[j].notified++;
+        count[j]++;
+    }
+
+    for(int j = 0; j < _size; j++)
+    {
+        if(count[j] > 0)
+        {
+            send(_process[j]._pipefd[0], (char*)&count[j], sizeof(count[j]), MSG_NOSIGNAL);
+        }
+    }
+
+    return true;
+}
+
+//每轮最多取出PASS_FD_MAX个连接，按选中的子进程分组，每个子进程只需要一次sendmsg
+//父进程同时持有的连接不超过一轮，不会因为连接风暴耗尽父进程的描述符
+template<class T>
+void ProcessPool<T>::accept_passfd()
+{
+    int conns[PASS_FD_MAX];
+    sockaddr_in addrs[PASS_FD_MAX];
+    int owner[PASS_FD_MAX];
+
+    bool more = true;
+    while(more)
+    {
+        int n = 0;
+        while(n < PASS_FD_MAX)
+        {
+            sockaddr_in addr;
+            socklen_t len = sizeof(addr);
+
+            int connfd = accept4(_listen_fd, (sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(connfd < 0)
+            {
+                if(errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+                more = false;
+                break;
+            }
+
+            //父进程知道客户端地址，按地址哈希也能精确分配
+            int j = select_child(&addr);
+            if(j == -1)
+            {
+                close(connfd);
+                _stop = true;
+                more = false;
+                break;
+            }
+
+            //分配时立即计数，同一轮中后面的连接就能看到前面的分配结果
+            _load[j].active++;
+
+            conns[n] = connfd;
+            addrs[n] = addr;
+            owner[n] = j;
+            n++;
+        }
+
+        int fds[PASS_FD_MAX];
+        sockaddr_in batch[PASS_FD_MAX];
+        for(int j = 0; j < _size && n > 0; j++)
+        {
+            int count = 0;
+            for(int k = 0; k < n; k++)
+            {
+                if(owner[k] == j)
+                {
+                    fds[count] = conns[k];
+                    batch[count] = addrs[k];
+                    count++;
+                }
+            }
+
+            if(count == 0)
+            {
+                continue;
+            }
+
+            //发送失败说明子进程已经退出，这批连接只能关闭
+            if(!send_fds(_process[j]._pipefd[0], fds, batch, count))
+            {
+                std::cout << "send fds to child " << j << " error." << std::endl;
+                _load[j].active -= count;
+            }
+
+            //子进程已经拥有了这些连接，父进程关闭自己的一份
+            for(int k = 0; k < count; k++)
+            {
+                close(fds[k]);
+            }
+        }
+    }
+}
+
+//父进程在分配时已经计过数，这里只标记连接属于本进程，关闭时由conn_checked减去
+template<class T>
+void ProcessPool<T>::recv_passfd(T* user)
+{
+    int pipefd = _process[_id]._pipefd[1];
+    int fds[PASS_FD_MAX];
+    sockaddr_in addrs[PASS_FD_MAX];
+
+    while(true)
+    {
+        int n = recv_fds(pipefd, fds, addrs, PASS_FD_MAX);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n == 0)
+        {
+            //父进程已经退出
+            _stop = true;
+            break;
+        }
+        if(n < 0)
+        {
+            break;
+        }
+
+        for(int i = 0; i < n; i++)
+        {
+            int connfd = fds[i];
+
+            //描述符被内核丢弃，或者超出单个子进程能处理的最大客户量
+            if(connfd < 0 || connfd >= USER_PER_PROCESS)
+            {
+                if(connfd >= 0)
+                {
+                    close(connfd);
+                }
+                _load[_id].active--;
+                continue;
+            }
+
+            epoll_add_fd(_epoll_fd, connfd);
+            user[connfd].init(_epoll_fd, connfd, addrs[i]);
+            _conn_open[connfd] = true;
+        }
+    }
+}
+
+template<class T>
+int ProcessPool<T>::select_child(const sockaddr_in* addr)
+{
+    //收集存活的子进程
+    int alive[MAX_PROCESS_NUMBER];
+    int count = 0;
+    for(int i = 0; i < _size; i++)
+    {
+        if(_process[i]._pid != -1)
+        {
+            alive[count++] = i;
+        }
+    }
+
+    if(count == 0)
+    {
+        return -1;
+    }
+
+    //负载包括已经通知但子进程还没有取走的连接
+    int load[MAX_PROCESS_NUMBER];
+    for(int k = 0; k < count; k++)
+    {
+        load[k] = _load[alive[k]].active + _load[alive[k]].notified;
+    }
+
+    int j = -1;
+    switch(_policy)
+    {
+        case DISPATCH_LEAST_ACTIVE:
+        {
+            int min = 0;
+            for(int k = 1; k < count; k++)
+            {
+                if(load[k] < load[min])
+                {
+                    min = k;
+                }
+            }
+            j = alive[min];
+            break;
+        }
+        case DISPATCH_POWER_OF_TWO:
+        {
+            //只比较两个随机的子进程，不需要扫描全部负载，也不会让所有新连接同时涌向同一个最空闲的子进程
+            int a = rand() % count;
+            int b = rand() % count;
+            j = (load[b] < load[a]) ? alive[b] : alive[a];
+            break;
+        }
+        case DISPATCH_HASH_ADDR:
+        {
+            if(addr != nullptr)
+            {
+                //乘法哈希的低位只由地址的低位决定，取混合最充分的高16位
+                uint32_t h = ntohl(addr->sin_addr.s_addr) * 2654435761u;
+                j = alive[(h >> 16) % count];
+                break;
+            }
+        }
+        //不知道客户端地址时退化为轮询
+        // fall through
+        case DISPATCH_ROUND_ROBIN:
+        default:
+        {
+            //使用Round Robin算法将新连接轮询分配给子进程，跳过已经退出的子进程
+            j = _next;
+            while(_process[j]._pid == -1)
+            {
+                j = (j + 1) % _size;
+            }
+            break;
+        }
+    }
+
+    _next = (j + 1) % _size;
+    return j;
+}
+
+template<class T>
+void ProcessPool<T>::conn_opened(int connfd)
+{
+    if(!_conn_open[connfd])
+    {
+        _conn_open[connfd] = true;
+        _load[_id].active++;
+    }
+}
+
+//用户任务在process中关闭连接时进程池并不知道，处理完事件后检查描述符是否还有效
+template<class T>
+void ProcessPool<T>::conn_checked(int connfd)
+{
+    if(_conn_open[connfd] && fcntl(connfd, F_GETFD) == -1 && errno == EBADF)
+    {
+        _conn_open[connfd] = false;
+        _load[_id].active--;
+    }
+}
+
 #endif /*__PROCESS_POOL_H__ */
@@ -0,0 +1,357 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <iostream>
+
+static const int DEFAULT_THREAD_NUMBER = 8;     //线程池默认的线程数
+static const int MAX_THREAD_NUMBER = 256;       //线程池的最大线程数
+
+//任务函数，参数由提交任务的一方传入，使用函数指针而不是std::function，提交任务时不需要分配内存
+typedef void (*TaskFunc)(void* arg);
+
+struct Task
+{
+    TaskFunc func;
+    void* arg;
+};
+
+//工作线程的描述信息
+struct Worker
+{
+    pthread_t tid;
+    pthread_mutex_t mutex;          //保护本地队列，绝大多数时间只有自己在用，基本没有竞争
+    std::deque<Task> tasks;         //本地双端队列，自己从尾部取，其他线程从头部窃取
+    std::atomic<unsigned long long> executed;   //执行过的任务数
+    std::atomic<unsigned long long> steals;     //从其他线程窃取的任务数
+    char pad[64];                   //填充一个缓存行，避免相邻线程的队列锁和计数器产生伪共享
+};
+
+//线程池统计信息
+struct ThreadPoolStat
+{
+    size_t global_depth;        //全局队列中等待的任务数
+    size_t local_depth;         //所有本地队列中等待的任务数之和
+    unsigned long long executed;
+    unsigned long long steals;
+};
+
+//固定大小的工作窃取线程池
+//外部线程提交的任务放入全局注入队列，工作线程在任务中提交的新任务放入自己的本地队列
+//工作线程依次从本地队列尾部、全局队列、其他线程本地队列头部取任务，全部为空时才睡眠
+class ThreadPool
+{
+public:
+    ThreadPool(int thread_number = DEFAULT_THREAD_NUMBER)
+        : _size(thread_number)
+        , _stop(false)
+        , _started(false)
+        , _pending(0)
+        , _idle(0)
+    {
+        if(_size <= 0 || _size > MAX_THREAD_NUMBER)
+        {
+            _size = DEFAULT_THREAD_NUMBER;
+        }
+
+        _workers = new Worker[_size];
+        for(int i = 0; i < _size; i++)
+        {
+            pthread_mutex_init(&_workers[i].mutex, NULL);
+            _workers[i].executed = 0;
+            _workers[i].steals = 0;
+        }
+
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_cond, NULL);
+    }
+
+    ~ThreadPool()
+    {
+        stop();
+
+        for(int i = 0; i < _size; i++)
+        {
+            pthread_mutex_destroy(&_workers[i].mutex);
+        }
+        delete[] _workers;
+
+        pthread_mutex_destroy(&_mutex);
+        pthread_cond_destroy(&_cond);
+    }
+
+    //防拷贝
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    bool start();                           //启动所有工作线程
+    void stop();                            //执行完已提交的任务后停止所有工作线程
+    bool submit(TaskFunc func, void* arg);  //提交任务
+    ThreadPoolStat stat() const;            //获取队列深度以及执行和窃取的计数
+
+    int size() const
+    {
+        return _size;
+    }
+
+private:
+    //工作线程启动参数
+    struct WorkerArg
+    {
+        ThreadPool* pool;
+        int index;
+    };
+
+    //当前线程所属的线程池以及在池中的序号，不是工作线程时为-1
+    //放在内联函数的局部线程变量中，所有包含本头文件的编译单元共用同一份，不能定义成文件作用域的static变量
+    static ThreadPool*& current_pool()
+    {
+        static thread_local ThreadPool* t_pool = nullptr;
+        return t_pool;
+    }
+
+    static int& current_index()
+    {
+        static thread_local int t_index = -1;
+        return t_index;
+    }
+
+    static void* worker_routine(void* arg);
+    bool take(int index, Task& task);       //为第index个线程取一个任务，没有任务时返回false
+    void wake();                            //有新任务时唤醒一个睡眠的线程
+
+    int _size;                              //线程数
+    bool _stop;                             //是否停止运行
+    bool _started;                          //是否已经启动
+    Worker* _workers;                       //所有工作线程的描述信息
+    std::deque<Task> _global;               //全局注入队列，由_mutex保护
+    pthread_mutex_t _mutex;
+    pthread_cond_t _cond;                   //没有任务时工作线程在这里睡眠
+    std::atomic<long> _pending;             //所有队列中尚未取走的任务数
+    std::atomic<int> _idle;                 //正在睡眠的工作线程数
+};
+
+inline bool ThreadPool::start()
+{
+    if(_started)
+    {
+        return true;
+    }
+
+    for(int i = 0; i < _size; i++)
+    {
+        WorkerArg* arg = new WorkerArg;
+        arg->pool = this;
+        arg->index = i;
+
+        if(pthread_create(&_workers[i].tid, NULL, worker_routine, arg) != 0)
+        {
+            std::cerr << "thread pool create thread error" << std::endl;
+            delete arg;
+
+            //已经创建的线程正常停止
+            _size = i;
+            _started = true;
+            stop();
+            return false;
+        }
+    }
+
+    _started = true;
+    return true;
+}
+
+inline void ThreadPool::stop()
+{
+    pthread_mutex_lock(&_mutex);
+    if(_stop)
+    {
+        pthread_mutex_unlock(&_mutex);
+        return;
+    }
+    _stop = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_mutex);
+
+    if(!_started)
+    {
+        return;
+    }
+
+    for(int i = 0; i < _size; i++)
+    {
+        pthread_join(_workers[i].tid, NULL);
+    }
+}
+
+inline bool ThreadPool::submit(TaskFunc func, void* arg)
+{
+    Task task = { func, arg };
+
+    //工作线程提交的任务放入自己的本地队列，任务产生的子任务大概率用到同样的数据，本线程接着执行缓存更友好
+    if(current_pool() == this && current_index() >= 0)
+    {
+        Worker& self = _workers[current_index()];
+
+        pthread_mutex_lock(&self.mutex);
+        self.tasks.push_back(task);
+        pthread_mutex_unlock(&self.mutex);
+
+        _pending++;
+        wake();
+        return true;
+    }
+
+    pthread_mutex_lock(&_mutex);
+    if(_stop)
+    {
+        pthread_mutex_unlock(&_mutex);
+        return false;
+    }
+    _global.push_back(task);
+    _pending++;
+    if(_idle > 0)
+    {
+        pthread_cond_signal(&_cond);
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    return true;
+}
+
+inline void ThreadPool::wake()
+{
+    //先增加_pending再检查_idle，睡眠前先增加_idle再检查_pending，两边至少有一方能看到对方，不会丢失唤醒
+    if(_idle > 0)
+    {
+        pthread_mutex_lock(&_mutex);
+        pthread_cond_signal(&_cond);
+        pthread_mutex_unlock(&_mutex);
+    }
+}
+
+inline bool ThreadPool::take(int index, Task& task)
+{
+    Worker& self = _workers[index];
+
+    //本地队列尾部，最近提交的任务
+    pthread_mutex_lock(&self.mutex);
+    if(!self.tasks.empty())
+    {
+        task = self.tasks.back();
+        self.tasks.pop_back();
+        pthread_mutex_unlock(&self.mutex);
+
+        _pending--;
+        return true;
+    }
+    pthread_mutex_unlock(&self.mutex);
+
+    //全局注入队列
+    pthread_mutex_lock(&_mutex);
+    if(!_global.empty())
+    {
+        task = _global.front();
+        _global.pop_front();
+        pthread_mutex_unlock(&_mutex);
+
+        _pending--;
+        return true;
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    //从其他线程本地队列的头部窃取，从自己的下一个开始轮询，避免所有线程都去抢同一个队列
+    for(int i = 1; i < _size; i++)
+    {
+        Worker& victim = _workers[(index + i) % _size];
+
+        //对方正在操作自己的队列时直接跳过，不在窃取上等锁
+        if(pthread_mutex_trylock(&victim.mutex) != 0)
+        {
+            continue;
+        }
+
+        if(!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            pthread_mutex_unlock(&victim.mutex);
+
+            _pending--;
+            self.steals++;
+            return true;
+        }
+        pthread_mutex_unlock(&victim.mutex);
+    }
+
+    return false;
+}
+
+inline void* ThreadPool::worker_routine(void* arg)
+{
+    WorkerArg* warg = (WorkerArg*)arg;
+    ThreadPool* pool = warg->pool;
+    int index = warg->index;
+    delete warg;
+
+    current_pool() = pool;
+    current_index() = index;
+
+    while(1)
+    {
+        Task task;
+        if(pool->take(index, task))
+        {
+            task.func(task.arg);
+            pool->_workers[index].executed++;
+            continue;
+        }
+
+        //所有队列都为空，睡眠等待新任务；停止时要先把剩余任务执行完
+        pthread_mutex_lock(&pool->_mutex);
+        pool->_idle++;
+        while(pool->_pending == 0 && !pool->_stop)
+        {
+            pthread_cond_wait(&pool->_cond, &pool->_mutex);
+        }
+        pool->_idle--;
+        bool quit = pool->_stop && pool->_pending == 0;
+        pthread_mutex_unlock(&pool->_mutex);
+
+        if(quit)
+        {
+            break;
+        }
+    }
+
+    return nullptr;
+}
+
+inline ThreadPoolStat ThreadPool::stat() const
+{
+    ThreadPoolStat st = { 0, 0, 0, 0 };
+
+    pthread_mutex_lock(const_cast<pthread_mutex_t*>(&_mutex));
+    st.global_depth = _global.size();
+    pthread_mutex_unlock(const_cast<pthread_mutex_t*>(&_mutex));
+
+    for(int i = 0; i < _size; i++)
+    {
+        Worker& worker = _workers[i];
+
+        pthread_mutex_lock(&worker.mutex);
+        st.local_depth += worker.tasks.size();
+        pthread_mutex_unlock(&worker.mutex);
+
+        st.executed += worker.executed;
+        st.steals += worker.steals;
+    }
+
+    return st;
+}
+
+#endif /*__THREAD_POOL_H__ */
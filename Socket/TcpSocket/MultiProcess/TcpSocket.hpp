@@ -21,6 +21,16 @@ class TcpSocket
         TcpSocket() : _socket_fd(-1)
         {}
 
+        int GetFd() const 
+        {
+            return _socket_fd;
+        }
+
+        void SetFd(int fd)
+        {
+            _socket_fd = fd;
+        }
+
         //创建套接字
         bool Socket()
         {
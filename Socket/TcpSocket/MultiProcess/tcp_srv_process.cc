@@ -1,34 +1,343 @@
 #include<iostream>
+#include<string>
+#include<vector>
+#include<unordered_map>
 #include<signal.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<sched.h>
+#include<unistd.h>
 #include<sys/wait.h>
+#include<sys/epoll.h>
 #include"TcpSocket.hpp"
 
 using namespace std;
 
+const int MAX_EVENTS = 1024;
+const int DEFAULT_WORKER_NUM = 4;
+const int ACCEPT_BATCH = 8;     //工作进程每次唤醒最多accept的连接数
+
+//预派生模式下收到退出信号的标记
+static volatile sig_atomic_t g_stop = 0;
+
 void sigcb(int no)
 {
     while(waitpid(-1, NULL, WNOHANG) > 0);
 }
 
+void stopcb(int no)
+{
+    g_stop = 1;
+}
+
+//发送数据，写不完的部分放入pending，开启可写事件监控
+static bool echo_send(int epfd, int fd, string& pending, const char* data, size_t len)
+{
+    size_t pos = 0;
+
+    //已经有积压时只能排在后面
+    while(pending.empty() && pos < len)
+    {
+        ssize_t ret = send(fd, data + pos, len - pos, MSG_NOSIGNAL);
+        if(ret < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            return false;
+        }
+        pos += ret;
+    }
+
+    if(pos == len)
+    {
+        return true;
+    }
+
+    bool was_empty = pending.empty();
+    pending.append(data + pos, len - pos);
+
+    if(was_empty)
+    {
+        struct epoll_event ev;
+        ev.data.fd = fd;
+        ev.events = EPOLLIN | EPOLLOUT;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+    return true;
+}
+
+//可写事件就绪时发送积压的数据，发送完毕后关闭可写事件监控
+static bool echo_flush(int epfd, int fd, string& pending)
+{
+    while(!pending.empty())
+    {
+        ssize_t ret = send(fd, pending.data(), pending.size(), MSG_NOSIGNAL);
+        if(ret < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        pending.erase(0, ret);
+    }
+
+    struct epoll_event ev;
+    ev.data.fd = fd;
+    ev.events = EPOLLIN;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+
+    return true;
+}
+
+//预派生的工作进程，每个进程有自己的epoll，以EPOLLEXCLUSIVE方式监控继承来的监听套接字并直接accept
+//新连接到来时内核只唤醒其中一个等待的进程，不会出现惊群，一个进程可以同时服务多个连接
+static void worker_loop(int id, int lst_fd)
+{
+    //工作进程恢复默认的信号处理，由父进程统一管理
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(epfd < 0)
+    {
+        cerr << "worker " << id << " epoll create error" << endl;
+        exit(1);
+    }
+
+    struct epoll_event ev;
+    ev.data.fd = lst_fd;
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    if(epoll_ctl(epfd, EPOLL_CTL_ADD, lst_fd, &ev) < 0)
+    {
+        cerr << "worker " << id << " epoll add listener error" << endl;
+        exit(1);
+    }
+
+    //每个连接尚未发送出去的数据
+    unordered_map<int, string> pending;
+    struct epoll_event evs[MAX_EVENTS];
+    char buff[4096];
+
+    while(1)
+    {
+        int num = epoll_wait(epfd, evs, MAX_EVENTS, -1);
+        if(num < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            cerr << "worker " << id << " epoll wait error" << endl;
+            exit(1);
+        }
+
+        for(int i = 0; i < num; i++)
+        {
+            int fd = evs[i].data.fd;
+
+            //新连接到来，每次唤醒最多取ACCEPT_BATCH个，其他进程可能已经取走，EAGAIN属于正常情况
+            if(fd == lst_fd)
+            {
+                int accepted = 0;
+                while(accepted < ACCEPT_BATCH)
+                {
+                    int new_fd = accept4(lst_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if(new_fd < 0)
+                    {
+                        if(errno == EINTR)
+                        {
+                            continue;
+                        }
+                        //被客户端放弃的连接已经出队，也算作一个
+                        if(errno == ECONNABORTED)
+                        {
+                            accepted++;
+                            continue;
+                        }
+                        break;
+                    }
+                    accepted++;
+
+                    struct epoll_event cev;
+                    cev.data.fd = new_fd;
+                    cev.events = EPOLLIN;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, new_fd, &cev);
+                }
+
+                //取满说明队列中还有连接，让出CPU给同样被唤醒的其他工作进程去取
+                //否则监听套接字一直可读，先运行的进程会在时间片内取走整个队列
+                if(accepted == ACCEPT_BATCH)
+                {
+                    sched_yield();
+                }
+                //队列已经取空，重新注册监听套接字，排到监听套接字等待队列的末尾
+                //EPOLLEXCLUSIVE总是唤醒等待队列中第一个空闲的进程，不轮换的话刚处理完的进程会一直优先被唤醒
+                else
+                {
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, lst_fd, NULL);
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, lst_fd, &ev);
+                }
+                continue;
+            }
+
+            bool ok = true;
+            if(evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+            {
+                ssize_t ret = recv(fd, buff, sizeof(buff), 0);
+
+                if(ret > 0)
+                {
+                    cout << "worker " << id << " cli send message: " << string(buff, ret) << endl;
+                    ok = echo_send(epfd, fd, pending[fd], buff, ret);
+                }
+                else if(ret == 0 || (errno != EAGAIN && errno != EINTR))
+                {
+                    ok = false;
+                }
+            }
+
+            if(ok && (evs[i].events & EPOLLOUT))
+            {
+                ok = echo_flush(epfd, fd, pending[fd]);
+            }
+
+            //断开连接，移除监控
+            if(!ok)
+            {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+                pending.erase(fd);
+                close(fd);
+            }
+        }
+    }
+}
+
+static pid_t spawn_worker(int id, int lst_fd)
+{
+    pid_t pid = fork();
+
+    if(pid == 0)
+    {
+        worker_loop(id, lst_fd);
+        exit(0);
+    }
+    else if(pid < 0)
+    {
+        cerr << "fork worker " << id << " error" << endl;
+    }
+
+    return pid;
+}
+
+//预派生模式：启动时一次创建所有工作进程，父进程只负责监管，工作进程退出时才重新创建
+static int run_prefork(TcpSocket& socket, int worker_num)
+{
+    int lst_fd = socket.GetFd();
+    //多个进程共享监听套接字，必须是非阻塞的，否则没抢到连接的进程会阻塞在accept上
+    fcntl(lst_fd, F_SETFL, fcntl(lst_fd, F_GETFL) | O_NONBLOCK);
+
+    struct sigaction sa;
+    sa.sa_handler = stopcb;
+    sa.sa_flags = 0;    //不设置SA_RESTART，让waitpid被信号打断
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+
+    vector<pid_t> workers(worker_num, -1);
+    for(int i = 0; i < worker_num; i++)
+    {
+        workers[i] = spawn_worker(i, lst_fd);
+    }
+
+    while(!g_stop)
+    {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+
+        if(pid < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            //没有子进程了，可能是全部创建失败
+            break;
+        }
+
+        for(int i = 0; i < worker_num; i++)
+        {
+            if(workers[i] == pid)
+            {
+                cerr << "worker " << i << " pid " << pid << " exit, restart" << endl;
+                //创建失败时稍等再试，避免疯狂重试
+                workers[i] = spawn_worker(i, lst_fd);
+                if(workers[i] < 0)
+                {
+                    sleep(1);
+                }
+                break;
+            }
+        }
+    }
+
+    //通知所有工作进程退出并回收
+    for(int i = 0; i < worker_num; i++)
+    {
+        if(workers[i] > 0)
+        {
+            kill(workers[i], SIGTERM);
+        }
+    }
+    while(waitpid(-1, NULL, 0) > 0);
+
+    socket.Close();
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
-    if(argc != 3)
+    if(argc != 3 && argc != 5)
     {   
-        cerr << "正确输入方式: ./tcp_srv_process.cc. ip port\n" << endl;
+        cerr << "正确输入方式: ./tcp_srv_process.cc. ip port [prefork worker_num]\n" << endl;
         return -1; 
     } 
 
-    signal(SIGCHLD, sigcb);
     string srv_ip = argv[1];
     uint16_t srv_port = stoi(argv[2]);
+    bool prefork = (argc == 5);
+
+    //第三个参数只支持prefork，其他模式直接报错，不能悄悄退回每个连接一个进程的模式
+    if(prefork && string(argv[3]) != "prefork")
+    {
+        cerr << "未知的模式: " << argv[3] << endl;
+        cerr << "正确输入方式: ./tcp_srv_process.cc. ip port [prefork worker_num]\n" << endl;
+        return -1;
+    }
 
     TcpSocket socket;
     //创建套接字
     CheckSafe(socket.Socket());
     //绑定地址信息
     CheckSafe(socket.Bind(srv_ip, srv_port));
-    //开始监听
-    CheckSafe(socket.Listen());
+    //开始监听，预派生模式由多个进程一起accept，使用更大的全连接队列
+    CheckSafe(prefork ? socket.Listen(SOMAXCONN) : socket.Listen());
+
+    if(prefork)
+    {
+        int worker_num = stoi(argv[4]);
+        return run_prefork(socket, worker_num > 0 ? worker_num : DEFAULT_WORKER_NUM);
+    }
+
+    signal(SIGCHLD, sigcb);
 
     while(1)
     {
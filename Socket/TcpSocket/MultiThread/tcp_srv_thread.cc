@@ -1,45 +1,68 @@
 #include<iostream>
-#include"TcpSocket.hpp"
+#include<sys/epoll.h>
 #include<pthread.h>
+#include"TcpSocket.hpp"
+#include"../../../Pool/ThreadPool/thread_pool.h"
 
 using namespace std;
 
-void* thr_work(void* arg)
+static const int MAX_EVENTS = 1024;
+static int g_epoll_fd = -1;     //主线程监控所有连接，工作线程处理完请求后重新注册
+static pthread_mutex_t g_console_lock = PTHREAD_MUTEX_INITIALIZER;  //多个工作线程同时回复时，提示和输入要成对出现
+
+//以EPOLLONESHOT方式监控连接，触发一次后自动停止监控，同一个连接同时只会有一个任务在处理
+static bool watch_conn(int fd, int op)
 {
-    //因为参数只能是void*，所以要强转获取操作句柄，所以读取前四个字节即可
-    
-    long fd = (long)arg;
+    struct epoll_event event;
+    event.data.fd = fd;
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+
+    return epoll_ctl(g_epoll_fd, op, fd, &event) == 0;
+}
+
+//请求任务，参数为就绪连接的描述符，只处理一次请求和回复，处理完后交还给主线程继续监控
+//工作线程不会被一个长会话占住，连接数超过线程数时新连接也能得到处理
+void request_task(void* arg)
+{
+    //描述符直接存放在指针中传递，不需要为每个连接分配内存
+    int fd = (int)(long)arg;
     TcpSocket new_sock;
     new_sock.SetFd(fd);
 
-    while(1)
+    string data;
+    //接收数据，对端关闭或出错时结束会话，关闭描述符时自动从epoll中移除
+    if(!new_sock.Recv(data))
     {
-        string data;
-        //接收数据
-        new_sock.Recv(data);
-        cout << "cli send message: " << data << endl;
-        data.clear();
+        new_sock.Close();
+        return;
+    }
 
-        cout << "srv reply message: ";
-        //发送数据
-        getline(cin, data);
-        new_sock.Send(data);
+    pthread_mutex_lock(&g_console_lock);
+    cout << "cli send message: " << data << endl;
+    data.clear();
 
+    cout << "srv reply message: ";
+    getline(cin, data);
+    pthread_mutex_unlock(&g_console_lock);
+
+    //发送数据
+    if(!new_sock.Send(data) || !watch_conn(fd, EPOLL_CTL_MOD))
+    {
+        new_sock.Close();
     }
-    new_sock.Close();
-    return nullptr;
 }
 
 int main(int argc, char* argv[])
 {
-    if(argc != 3)
-    {   
-        cerr << "正确输入方式: ./tcp_srv_thread.cc. ip port\n" << endl;
-        return -1; 
-    } 
+    if(argc != 3 && argc != 4)
+    {
+        cerr << "正确输入方式: ./tcp_srv_thread.cc. ip port [thread_num]\n" << endl;
+        return -1;
+    }
 
     string srv_ip = argv[1];
     uint16_t srv_port = stoi(argv[2]);
+    int thread_num = (argc == 4) ? stoi(argv[3]) : DEFAULT_THREAD_NUMBER;
 
     TcpSocket lst_socket;
     //创建监听套接字
@@ -49,35 +72,71 @@ int main(int argc, char* argv[])
     //开始监听
     CheckSafe(lst_socket.Listen());
 
+    g_epoll_fd = epoll_create(MAX_EVENTS);
+    CheckSafe(g_epoll_fd != -1);
+
+    struct epoll_event lst_event;
+    lst_event.data.fd = lst_socket.GetFd();
+    lst_event.events = EPOLLIN;
+    CheckSafe(epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, lst_socket.GetFd(), &lst_event) == 0);
+
+    //固定数量的工作线程，主线程只负责监控，每个就绪的请求作为一个任务提交，不再让一个连接独占一个线程
+    ThreadPool pool(thread_num);
+    CheckSafe(pool.start());
+
+    struct epoll_event events[MAX_EVENTS];
     while(1)
     {
-        TcpSocket* new_sock = new TcpSocket();
-        //通过监听套接字获取连接
-        bool ret = lst_socket.Accept(new_sock);
-      
-        //连接失败则重新连接
-        if(!ret)
+        int num = epoll_wait(g_epoll_fd, events, MAX_EVENTS, -1);
+        if(num < 0)
         {
-            cerr << "连接失败" << endl;
-            continue;
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            cerr << "epoll_wait error" << endl;
+            break;
         }
 
-        //创建线程
-        pthread_t tid;
-        
-        int res = pthread_create(&tid, NULL, thr_work, (void*)new_sock->GetFd());
-
-        if(res != 0)
+        for(int i = 0; i < num; i++)
         {
-            cerr << "线程创建失败" << endl;
-            continue;
+            int fd = events[i].data.fd;
+
+            //新连接到来
+            if(fd == lst_socket.GetFd())
+            {
+                TcpSocket new_sock;
+                //通过监听套接字获取连接，连接失败则等待下一次就绪
+                if(!lst_socket.Accept(&new_sock))
+                {
+                    cerr << "连接失败" << endl;
+                    continue;
+                }
+
+                if(!watch_conn(new_sock.GetFd(), EPOLL_CTL_ADD))
+                {
+                    new_sock.Close();
+                }
+                continue;
+            }
+
+            //将请求任务放入线程池
+            if(!pool.submit(request_task, (void*)(long)fd))
+            {
+                cerr << "任务提交失败" << endl;
+                close(fd);
+                continue;
+            }
         }
-        
-        //不需要知道返回值，所以直接分离线程
-        pthread_detach(tid);
     }
 
+    //停止线程池，退出时输出一次统计信息
+    pool.stop();
+    ThreadPoolStat st = pool.stat();
+    cerr << "pool executed: " << st.executed << " steals: " << st.steals << endl;
+
     //关闭监听套接字
+    close(g_epoll_fd);
     lst_socket.Close();
     return 0;
 }
@@ -1,11 +1,32 @@
 #include<iostream>
+#include<algorithm>
 #include<sys/socket.h>
 #include<string>
 #include<arpa/inet.h>
 #include<netinet/in.h>
+#include<netinet/udp.h>
 #include<cstdio>
+#include<cstring>
+#include<vector>
 #include<unistd.h>
 
+//较老的头文件中没有分段卸载相关的定义，取值与内核一致
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+const size_t UDP_MAX_PAYLOAD = 65507;   //单个UDP报文的最大负载，GSO一次发送的总长度也不能超过它
+const int UDP_MAX_SEGMENTS = 64;        //GSO一次发送的最大分段数
+
+const int UDP_BATCH_SIZE = 64;          //一次批量收发的最大报文数
+const size_t UDP_BATCH_BUFSIZE = 2048;  //批量收发时每个报文的缓冲区大小
+
 inline void CheckSafe(bool ret)
 {
     if(ret == false)
@@ -15,6 +36,186 @@ inline void CheckSafe(bool ret)
     }
 }
 
+//预先解析好的对端地址，字符串只在构造时解析一次，之后收发都直接使用二进制地址
+//只有调用Ip或ToString时才会格式化字符串
+class Endpoint
+{
+    public:
+        Endpoint()
+        {
+            memset(&_addr, 0, sizeof(_addr));
+            _addr.sin_family = AF_INET;
+        }
+
+        Endpoint(const std::string& ip, uint16_t port)
+        {
+            memset(&_addr, 0, sizeof(_addr));
+            _addr.sin_family = AF_INET;
+            _addr.sin_port = htons(port);
+
+            if(inet_pton(AF_INET, ip.c_str(), &_addr.sin_addr) != 1)
+            {
+                std::cerr << "invalid ip address: " << ip << std::endl;
+                _addr.sin_addr.s_addr = htonl(INADDR_NONE);
+            }
+        }
+
+        explicit Endpoint(const struct sockaddr_in& addr)
+            : _addr(addr)
+        {}
+
+        const struct sockaddr_in& Addr() const
+        {
+            return _addr;
+        }
+
+        struct sockaddr* SockAddr()
+        {
+            return (struct sockaddr*)&_addr;
+        }
+
+        const struct sockaddr* SockAddr() const
+        {
+            return (const struct sockaddr*)&_addr;
+        }
+
+        socklen_t Len() const
+        {
+            return sizeof(_addr);
+        }
+
+        uint16_t Port() const
+        {
+            return ntohs(_addr.sin_port);
+        }
+
+        std::string Ip() const
+        {
+            char buff[INET_ADDRSTRLEN] = {0};
+            inet_ntop(AF_INET, &_addr.sin_addr, buff, sizeof(buff));
+
+            return buff;
+        }
+
+        //格式化为ip:port
+        std::string ToString() const
+        {
+            return Ip() + ":" + std::to_string(Port());
+        }
+
+        bool operator==(const Endpoint& other) const
+        {
+            return _addr.sin_addr.s_addr == other._addr.sin_addr.s_addr && _addr.sin_port == other._addr.sin_port;
+        }
+
+    private:
+        struct sockaddr_in _addr;
+};
+
+//批量收发使用的消息数组，所有缓冲区和地址在构造时一次分配，之后每轮收发都不再分配内存
+//接收后每个报文的数据、长度和对端地址保存在对应下标中，直接用同一个批次发送即可原样回复给各自的对端
+class UdpBatch
+{
+    public:
+        UdpBatch(int capacity = UDP_BATCH_SIZE, size_t buf_size = UDP_BATCH_BUFSIZE)
+            : _capacity(capacity)
+            , _buf_size(buf_size)
+            , _size(0)
+            , _truncated(0)
+            , _buffers(capacity * buf_size)
+            , _lens(capacity, 0)
+            , _addrs(capacity)
+            , _iovs(capacity)
+            , _msgs(capacity)
+        {
+            for(int i = 0; i < capacity; i++)
+            {
+                _iovs[i].iov_base = Data(i);
+                _iovs[i].iov_len = buf_size;
+
+                memset(&_msgs[i], 0, sizeof(struct mmsghdr));
+                _msgs[i].msg_hdr.msg_name = &_addrs[i];
+                _msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+                _msgs[i].msg_hdr.msg_iov = &_iovs[i];
+                _msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+        }
+
+        int Capacity() const
+        {
+            return _capacity;
+        }
+
+        //当前批次中的报文数量
+        int Size() const
+        {
+            return _size;
+        }
+
+        void Clear()
+        {
+            _size = 0;
+        }
+
+        //因为超过缓冲区大小被截断而丢弃的报文累计数量
+        unsigned long long Truncated() const
+        {
+            return _truncated;
+        }
+
+        //第i个报文的数据
+        char* Data(int i)
+        {
+            return &_buffers[i * _buf_size];
+        }
+
+        size_t Length(int i) const
+        {
+            return _lens[i];
+        }
+
+        //修改第i个报文的发送长度，用于在原缓冲区上改写回复
+        void SetLength(int i, size_t len)
+        {
+            _lens[i] = std::min(len, _buf_size);
+        }
+
+        //第i个报文的对端地址
+        const struct sockaddr_in& Peer(int i) const
+        {
+            return _addrs[i];
+        }
+
+        //追加一个待发送的报文，批次已满或报文超过缓冲区大小时返回false
+        bool Push(const char* data, size_t len, const struct sockaddr_in& peer)
+        {
+            if(_size >= _capacity || len > _buf_size)
+            {
+                return false;
+            }
+
+            memcpy(Data(_size), data, len);
+            _lens[_size] = len;
+            _addrs[_size] = peer;
+            _size++;
+
+            return true;
+        }
+
+    private:
+        friend class UdpSocket;
+
+        int _capacity;
+        size_t _buf_size;
+        int _size;
+        unsigned long long _truncated;
+        std::vector<char> _buffers;
+        std::vector<size_t> _lens;
+        std::vector<struct sockaddr_in> _addrs;
+        std::vector<struct iovec> _iovs;
+        std::vector<struct mmsghdr> _msgs;
+};
+
 class UdpSocket
 {
     public:
@@ -35,20 +236,31 @@ class UdpSocket
            return true;
         }
         
+        //开启端口复用，多个套接字绑定同一个端口后由内核按四元组哈希把流量分散到各个套接字，需要在Bind之前调用
+        bool SetReuseport()
+        {
+            int opt = 1;
+            int ret = setsockopt(_socket_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+            if(ret == -1)
+            {
+                perror("set reuseport error");
+                return false;
+            }
+
+            return true;
+        }
+
         //绑定地址信息
         bool Bind(const std::string& ip, uint16_t port)
         {
-            struct sockaddr_in addr;
-            addr.sin_family = AF_INET;
-            //主机字节序转换成网络字节序，方便统一
-            addr.sin_port = htons(port);
-            //将字符串的ip地址转为网络字节序的二进制数据
-            addr.sin_addr.s_addr = inet_addr(ip.c_str());
-
-            socklen_t len = sizeof(struct sockaddr_in);
+            return Bind(Endpoint(ip, port));
+        }
 
+        bool Bind(const Endpoint& local)
+        {
             //强转地址结构，使接口统一
-            int ret = bind(_socket_fd, (struct sockaddr*)& addr, len);
+            int ret = bind(_socket_fd, local.SockAddr(), local.Len());
 
             if(ret == -1)
             {
@@ -59,62 +271,291 @@ class UdpSocket
             return true;
         }
 
-        bool Recv(std::string& buff, std::string* ip = NULL, uint16_t* port = NULL)
+        //连接到固定的对端，之后可以用不带地址的Send和Recv收发，内核不再为每个报文查找路由和比较地址
+        //连接后只会收到该对端发来的报文
+        bool Connect(const Endpoint& peer)
         {
-            //对端地址信息
-            struct sockaddr_in peer_addr;
-            socklen_t len = sizeof(struct sockaddr_in);
-            
-            //接收缓冲区
-            char temp[1024] = {0};
+            int ret = connect(_socket_fd, peer.SockAddr(), peer.Len());
 
-            
-            int ret = recvfrom(_socket_fd, temp, 1024, 0, (struct sockaddr*)&peer_addr, &len);
-                
             if(ret == -1)
             {
-                perror("receive error");
+                perror("socket connect error");
                 return false;
+            }
+
+            return true;
+        }
+
+        //接收一个报文到调用者提供的缓冲区中，peer不为空时返回对端地址
+        //返回报文的实际长度，大于len说明报文被截断，出错返回-1
+        ssize_t Recv(char* buff, size_t len, Endpoint* peer = NULL)
+        {
+            socklen_t addr_len = sizeof(struct sockaddr_in);
+
+            ssize_t ret = recvfrom(_socket_fd, buff, len, MSG_TRUNC, peer == NULL ? NULL : peer->SockAddr(), peer == NULL ? NULL : &addr_len);
 
+            if(ret == -1)
+            {
+                perror("receive error");
             }
-            
+
+            return ret;
+        }
+
+        bool Recv(std::string& buff, std::string* ip = NULL, uint16_t* port = NULL)
+        {
+            //接收缓冲区，能够容纳最大的UDP报文
+            char temp[UDP_MAX_PAYLOAD];
+            Endpoint peer;
+
+            ssize_t ret = Recv(temp, sizeof(temp), &peer);
+            if(ret == -1)
+            {
+                return false;
+            }
+
             //将数据从缓冲区取出
-            buff.assign(temp, ret);
+            buff.assign(temp, std::min((size_t)ret, sizeof(temp)));
 
             //获取对端地址信息
             if(port != NULL)
             {
-                *port = htons(peer_addr.sin_port);
+                *port = peer.Port();
             }
 
             if(ip != NULL)
             {
-                *ip = inet_ntoa(peer_addr.sin_addr);
+                *ip = peer.Ip();
             }
 
             return true;
         }
 
-        bool Send(const std::string& data, const std::string& ip, const uint16_t& port)
+        //向已经连接的对端发送，返回发送的字节数，出错返回-1
+        ssize_t Send(const char* data, size_t len)
         {
-            struct sockaddr_in addr;
-            addr.sin_family = AF_INET;
-            addr.sin_port = htons(port);
+            ssize_t ret = send(_socket_fd, data, len, 0);
 
-            addr.sin_addr.s_addr = inet_addr(ip.c_str());
-            socklen_t len = sizeof(struct sockaddr_in);
+            if(ret == -1)
+            {
+                perror("send error");
+            }
 
-            int ret = sendto(_socket_fd, data.c_str(), data.size(), 0, (sockaddr*)& addr, len);
+            return ret;
+        }
+
+        //向预先解析好的地址发送，返回发送的字节数，出错返回-1
+        ssize_t SendTo(const char* data, size_t len, const Endpoint& peer)
+        {
+            ssize_t ret = sendto(_socket_fd, data, len, 0, peer.SockAddr(), peer.Len());
 
             if(ret == -1)
             {
                 perror("send error");
+            }
+
+            return ret;
+        }
+
+        bool Send(const std::string& data, const std::string& ip, const uint16_t& port)
+        {
+            return SendTo(data.data(), data.size(), Endpoint(ip, port)) != -1;
+        }
+
+        //批量接收，一次recvmmsg最多收满整个批次，阻塞到至少有一个报文为止，之后只取已经到达的报文
+        //超过缓冲区大小的报文会被内核截断，截断后的数据不完整，直接丢弃并计入Truncated
+        //返回收到的完整报文数量，可能为0，出错返回-1
+        int RecvBatch(UdpBatch& batch)
+        {
+            //缓冲区长度和地址长度都会被内核改写，每次接收前都要复位
+            for(int i = 0; i < batch._capacity; i++)
+            {
+                batch._iovs[i].iov_len = batch._buf_size;
+                batch._msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            }
+
+            int ret = recvmmsg(_socket_fd, &batch._msgs[0], batch._capacity, MSG_WAITFORONE, NULL);
+
+            if(ret == -1)
+            {
+                batch._size = 0;
+                perror("receive batch error");
+                return -1;
+            }
+
+            //丢弃被截断的报文，后面的报文依次前移，没有截断时不需要移动数据
+            int size = 0;
+            for(int i = 0; i < ret; i++)
+            {
+                if(batch._msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+                {
+                    batch._truncated++;
+                    continue;
+                }
+
+                if(size != i)
+                {
+                    memcpy(batch.Data(size), batch.Data(i), batch._msgs[i].msg_len);
+                    batch._addrs[size] = batch._addrs[i];
+                }
+                batch._lens[size] = batch._msgs[i].msg_len;
+                size++;
+            }
+            batch._size = size;
+
+            return size;
+        }
+
+        //批量发送批次中的全部报文，每个报文发往各自的对端地址
+        //sendmmsg可能只发送一部分，剩余部分继续发送，返回发送成功的报文数量，出错返回-1
+        int SendBatch(UdpBatch& batch)
+        {
+            for(int i = 0; i < batch._size; i++)
+            {
+                batch._iovs[i].iov_len = batch._lens[i];
+                batch._msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            }
+
+            int sent = 0;
+            while(sent < batch._size)
+            {
+                int ret = sendmmsg(_socket_fd, &batch._msgs[sent], batch._size - sent, 0);
+
+                if(ret == -1)
+                {
+                    perror("send batch error");
+                    return sent > 0 ? sent : -1;
+                }
+
+                sent += ret;
+            }
+
+            return sent;
+        }
+
+        //开启GRO，内核会把同一条流上连续到达的报文合并后一次交给RecvGro
+        bool SetGro(bool on = true)
+        {
+            int opt = on ? 1 : 0;
+            int ret = setsockopt(_socket_fd, SOL_UDP, UDP_GRO, &opt, sizeof(opt));
+
+            if(ret == -1)
+            {
+                perror("set udp gro error");
                 return false;
             }
 
             return true;
         }
 
+        //用GSO发送大块数据，数据按segment_size切分成多个报文，由内核或网卡完成分段，每次sendmsg最多发送64个分段
+        //返回发送的字节数，出错返回-1
+        ssize_t SendGso(const char* data, size_t len, uint16_t segment_size, const struct sockaddr_in& peer)
+        {
+            //分段大小超过单个报文的上限时一个分段也发不出去，max_chunk为0会导致死循环
+            if(segment_size == 0 || segment_size > UDP_MAX_PAYLOAD)
+            {
+                return -1;
+            }
+
+            //一次sendmsg的总长度不能超过单个报文的上限，且要按分段大小对齐
+            size_t max_chunk = std::min((size_t)segment_size * UDP_MAX_SEGMENTS, UDP_MAX_PAYLOAD / segment_size * segment_size);
+            size_t pos = 0;
+
+            while(pos < len)
+            {
+                size_t chunk = std::min(len - pos, max_chunk);
+
+                struct iovec iov;
+                iov.iov_base = (void*)(data + pos);
+                iov.iov_len = chunk;
+
+                char control[CMSG_SPACE(sizeof(uint16_t))] = {0};
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_name = (void*)&peer;
+                msg.msg_namelen = sizeof(struct sockaddr_in);
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+
+                //只有一个分段时不需要附带分段大小
+                if(chunk > segment_size)
+                {
+                    msg.msg_control = control;
+                    msg.msg_controllen = sizeof(control);
+
+                    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+                    cmsg->cmsg_level = SOL_UDP;
+                    cmsg->cmsg_type = UDP_SEGMENT;
+                    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                    memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(uint16_t));
+                }
+
+                ssize_t ret = sendmsg(_socket_fd, &msg, 0);
+                if(ret == -1)
+                {
+                    perror("send gso error");
+                    return pos > 0 ? (ssize_t)pos : -1;
+                }
+
+                pos += ret;
+            }
+
+            return pos;
+        }
+
+        ssize_t SendGso(const char* data, size_t len, uint16_t segment_size, const Endpoint& peer)
+        {
+            return SendGso(data, len, segment_size, peer.Addr());
+        }
+
+        //接收一个可能经过GRO合并的报文，buff需要能容纳UDP_MAX_PAYLOAD字节，否则合并后的数据会被截断
+        //segment_size返回合并前每个报文的大小，最后一个报文可能更短；没有发生合并时等于返回的长度
+        //返回收到的字节数，出错返回-1
+        ssize_t RecvGro(char* buff, size_t len, size_t* segment_size, struct sockaddr_in* peer = NULL)
+        {
+            struct iovec iov;
+            iov.iov_base = buff;
+            iov.iov_len = len;
+
+            char control[CMSG_SPACE(sizeof(int))] = {0};
+            struct sockaddr_in peer_addr;
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_name = &peer_addr;
+            msg.msg_namelen = sizeof(struct sockaddr_in);
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            ssize_t ret = recvmsg(_socket_fd, &msg, 0);
+            if(ret == -1)
+            {
+                perror("receive gro error");
+                return -1;
+            }
+
+            *segment_size = ret;
+            for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            {
+                if(cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                {
+                    int gso_size = 0;
+                    memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(int));
+                    *segment_size = gso_size;
+                    break;
+                }
+            }
+
+            if(peer != NULL)
+            {
+                *peer = peer_addr;
+            }
+
+            return ret;
+        }
+
         void Close()
         {
             close(_socket_fd);
@@ -1,4 +1,5 @@
 #include<iostream>
+#include<vector>
 #include"UdpSocket.hpp"
 
 using namespace std;
@@ -21,7 +22,11 @@ int main (int argc, char *argv[])
     CheckSafe(Socket.Socket());
     
     //发送方不需要主动绑定地址信息，让系统自动选取即可，因为只需要保证能够发送数据，并且接收到数据即可，哪个地址端口都无所谓，这样还能减少端口冲突的概率
-    //发送数据
+    //服务器地址只解析一次，连接后收发都不再携带地址
+    CheckSafe(Socket.Connect(Endpoint(ip, port)));
+
+    //接收缓冲区，能够容纳最大的UDP报文
+    vector<char> buff(UDP_MAX_PAYLOAD);
     
     while(1)
     {
@@ -34,14 +39,13 @@ int main (int argc, char *argv[])
             break;
         
         //发送数据
-        CheckSafe(Socket.Send(message, ip, port));
-        
-        message.clear();
+        CheckSafe(Socket.Send(message.data(), message.size()) != -1);
         
         //接受数据
-        CheckSafe(Socket.Recv(message));
+        ssize_t ret = Socket.Recv(&buff[0], buff.size());
+        CheckSafe(ret != -1);
         
-        cout << "srv reply message: " << message << endl;
+        cout << "srv reply message: " << string(&buff[0], ret) << endl;
     }
 
     //关闭套接字
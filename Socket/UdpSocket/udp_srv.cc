@@ -1,14 +1,15 @@
 
 #include<iostream>
+#include<vector>
 #include"UdpSocket.hpp"
 
 using namespace std;
 
 int main (int argc, char *argv[])
 {
-    if(argc != 3)
+    if(argc != 3 && argc != 4)
     {
-        cerr << "正确输入方式: ./udp_srv.cpp ip port\n" << endl;
+        cerr << "正确输入方式: ./udp_srv.cpp ip port [batch|gro]\n" << endl;
         return -1;
     }
 
@@ -23,22 +24,62 @@ int main (int argc, char *argv[])
     //绑定地址信息
     CheckSafe(Socket.Bind(ip, port));
     
+    //批量模式：一次recvmmsg收一批报文，原样用sendmmsg回显给各自的对端
+    if(argc == 4 && string(argv[3]) == "batch")
+    {
+        UdpBatch batch;
+
+        while(1)
+        {
+            int ret = Socket.RecvBatch(batch);
+            if(ret <= 0)
+            {
+                continue;
+            }
+
+            Socket.SendBatch(batch);
+        }
+    }
+
+    //分段卸载模式：开启GRO一次接收合并后的多个报文，再按原分段大小用GSO一次回显
+    if(argc == 4 && string(argv[3]) == "gro")
+    {
+        CheckSafe(Socket.SetGro());
+        vector<char> buff(UDP_MAX_PAYLOAD);
+
+        while(1)
+        {
+            struct sockaddr_in peer;
+            size_t segment_size = 0;
+
+            ssize_t ret = Socket.RecvGro(&buff[0], buff.size(), &segment_size, &peer);
+            if(ret <= 0)
+            {
+                continue;
+            }
+
+            Socket.SendGso(&buff[0], ret, segment_size, peer);
+        }
+    }
+
+    //接收缓冲区，能够容纳最大的UDP报文
+    vector<char> buff(UDP_MAX_PAYLOAD);
+
     while(1)
     {
-        string cli_ip;
-        uint16_t cli_port;
-        string message;
+        Endpoint cli;
         
-        //接受数据
-        CheckSafe(Socket.Recv(message, &cli_ip, &cli_port));        
-        cout << "cli[" << cli_ip << ":" << cli_port << "]:send message: " <<  message <<  endl;
+        //接受数据，对端地址只在打印时才格式化
+        ssize_t ret = Socket.Recv(&buff[0], buff.size(), &cli);
+        CheckSafe(ret != -1);
+        cout << "cli[" << cli.ToString() << "]:send message: " << string(&buff[0], min((size_t)ret, buff.size())) << endl;
 
-        message.clear();
+        string message;
         cout << "srv send reply message: "; 
         getline(cin, message);
         
         //给客户端回复数据
-        CheckSafe(Socket.Send(message, cli_ip, cli_port));
+        CheckSafe(Socket.SendTo(message.data(), message.size(), cli) != -1);
     }
 
     //关闭套接字
@@ -0,0 +1,143 @@
+#include<iostream>
+#include<iomanip>
+#include<string>
+#include<vector>
+#include<atomic>
+#include<pthread.h>
+#include<sched.h>
+#include<unistd.h>
+#include"UdpSocket.hpp"
+
+using namespace std;
+
+const int DEFAULT_THREAD_NUM = 4;
+
+const size_t CACHE_LINE_SIZE = 64;
+
+//每个线程独占一个计数器，填充到一个缓存行大小，避免线程之间的伪共享
+//C++11中vector的默认分配器不保证alignas(64)的对齐，所以不依赖对齐，相邻两个计数器至少相隔一个缓存行
+struct ThreadStat
+{
+    atomic<unsigned long long> packets;
+    char pad[CACHE_LINE_SIZE - sizeof(atomic<unsigned long long>)];
+};
+
+struct WorkerArg
+{
+    int id;
+    string ip;
+    uint16_t port;
+    ThreadStat* stat;
+};
+
+//把当前线程绑定到指定的CPU上，CPU数量不够时轮流复用
+static void BindCpu(int id)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if(cpus <= 0)
+    {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(id % cpus, &set);
+
+    if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    {
+        cerr << "thread " << id << " set affinity error" << endl;
+    }
+}
+
+//每个线程拥有自己的套接字，全部绑定同一个端口，由内核把不同的流分散到各个线程
+void* worker(void* arg)
+{
+    WorkerArg* warg = (WorkerArg*)arg;
+    BindCpu(warg->id);
+
+    UdpSocket socket;
+    CheckSafe(socket.Socket());
+    CheckSafe(socket.SetReuseport());
+    CheckSafe(socket.Bind(warg->ip, warg->port));
+
+    //批量接收并原样回显
+    UdpBatch batch;
+    while(1)
+    {
+        int ret = socket.RecvBatch(batch);
+        if(ret <= 0)
+        {
+            continue;
+        }
+
+        warg->stat->packets.fetch_add(ret, memory_order_relaxed);
+        socket.SendBatch(batch);
+    }
+
+    socket.Close();
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc != 3 && argc != 4)
+    {
+        cerr << "正确输入方式: ./udp_srv_reuseport ip port [thread_num]\n" << endl;
+        return -1;
+    }
+
+    string ip = argv[1];
+    uint16_t port = stoi(argv[2]);
+    int thread_num = (argc == 4) ? stoi(argv[3]) : DEFAULT_THREAD_NUM;
+
+    if(thread_num <= 0)
+    {
+        cerr << "thread_num must be positive" << endl;
+        return -1;
+    }
+
+    vector<ThreadStat> stats(thread_num);
+    vector<WorkerArg> args(thread_num);
+    vector<pthread_t> tids(thread_num);
+
+    for(int i = 0; i < thread_num; i++)
+    {
+        stats[i].packets = 0;
+
+        args[i].id = i;
+        args[i].ip = ip;
+        args[i].port = port;
+        args[i].stat = &stats[i];
+
+        if(pthread_create(&tids[i], NULL, worker, &args[i]) != 0)
+        {
+            cerr << "thread create error" << endl;
+            return -1;
+        }
+    }
+
+    //每秒输出一次各线程的收包速率，用于确认流量在各个线程之间是否均衡
+    vector<unsigned long long> last(thread_num, 0);
+    while(1)
+    {
+        sleep(1);
+
+        unsigned long long total = 0;
+        cout << "pps:";
+        for(int i = 0; i < thread_num; i++)
+        {
+            unsigned long long now = stats[i].packets.load(memory_order_relaxed);
+            cout << " [" << i << "]" << now - last[i];
+            total += now - last[i];
+            last[i] = now;
+        }
+        cout << " total " << total << endl;
+    }
+
+    for(int i = 0; i < thread_num; i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+
+    return 0;
+}
@@ -2,10 +2,19 @@
 #define __TIMER_HEAP_H__
 
 #include<time.h>
+#include<stdlib.h>
 #include<iostream>
+#include<new>
+#include<stdint.h>
 #include<netinet/in.h>
+#include"../TimerService/loop_clock.h"
 
 const int MAX_BUFFER_SIZE = 1024;
+const int HEAP_ARITY = 4;   //每个节点的子节点数
+const int HEAP_LINE_SIZE = 64;  //缓存行大小
+//数组前面空出3个元素再按缓存行对齐，下标为i的节点的4个子节点4i+1到4i+4实际位于第4(i+1)到4(i+1)+3个位置
+//每个元素16字节，4个子节点正好占满同一个缓存行，向下调整时比较子节点只需要访问一个缓存行
+const int HEAP_PAD = HEAP_ARITY - 1;
 
 class heap_timer;
 
@@ -22,69 +31,62 @@ struct client_data
 class heap_timer
 {
 public:
+    //delay秒之后到期，内部以毫秒保存
     heap_timer(int delay)
+        : fun(nullptr)
+        , _user_data(nullptr)
+        , _index(-1)
     {
-        _expire = time(nullptr) + delay;
+        _expire = loop_clock::now() + (uint64_t)delay * 1000;
     }
 
-    time_t _expire;             //到期时间
+    uint64_t _expire;           //到期时间，单位为ms，以loop_clock为准
     void (*fun)(client_data*);  //处理函数
     client_data* _user_data;    //用户参数
+    int _index;                 //在堆数组中的下标，不在堆中时为-1
 };
 
-//定时器链表，带头尾双向链表，定时器以升序排序
+//堆中的元素，到期时间直接和定时器放在一起，比较时不需要访问定时器本身
+struct heap_entry
+{
+    uint64_t expire;
+    heap_timer* timer;
+};
+static_assert(sizeof(heap_entry) * HEAP_ARITY == HEAP_LINE_SIZE, "4 children must fill one cache line");
+
+//四叉最小堆，以到期时间排序
+//每个定时器记录自己在堆中的下标，删除和修改到期时间都是O(logn)，不需要伪删除
 class timer_heap
 {
 public:
-    timer_heap(int capacity = 10) throw (std::exception)
-        : _capacity(capacity)
+    timer_heap(int capacity = 10)
+        : _capacity(capacity > 0 ? capacity : 1)
         , _size(0)
     {
-        _array = new heap_timer* [_capacity];
-        //空间申请失败则抛出异常
-        if(_array == nullptr)
-        {
-            throw std::exception();
-        }
-
-        //初始化数组
-        for(int i = 0; i < _capacity; i++)
-        {
-            _array[i] = nullptr;
-        }
+        _array = alloc_entries(_capacity);
     }
 
     //使用定时器数组初始化
-    timer_heap(heap_timer** array, int capacity, int size) throw (std::exception)
+    timer_heap(heap_timer** array, int capacity, int size)
         : _capacity(capacity)
         , _size(size)
     {
-        _array = new heap_timer* [_capacity];
-
         //容量小于大小时抛出异常
-        if(capacity < size)
-        {
-            throw std::exception(); 
-        }
-        //空间申请失败则抛出异常
-        if(_array == nullptr)
+        if(capacity < size || capacity <= 0)
         {
             throw std::exception();
         }
 
+        _array = alloc_entries(_capacity);
+
         //拷贝数据
         for(int i = 0; i < _size; i++)
         {
-            _array[i] = array[i];
-        }
-        //初始化剩余空间
-        for(int i = _size; i < _capacity; i++)
-        {
-            _array[i] = nullptr;
+            set(i, array[i]);
         }
 
-        //从尾部开始调整堆
-        for(int i = (_size - 2) / 2; i >= 0; i--)
+        //从最后一个非叶子节点开始调整堆
+        for(int i = (_size - 2) / HEAP_ARITY; _size > 1 && i >= 0; i--)
         {
             adjust_down(i);
         }
@@ -92,13 +94,12 @@ public:
 
     ~timer_heap()
     {
-        for(int i = 0; i < _capacity; i++)
+        for(int i = 0; i < _size; i++)
         {
-            delete _array[i];
-            _array[i] = nullptr;
+            delete _array[i].timer;
         }
 
-        delete[] _array;
+        free_entries(_array);
         _array = nullptr;
     }
 
@@ -107,9 +108,9 @@ public:
     timer_heap& operator=(const timer_heap&) = delete;
 
     //将定时器插入时间堆中
-    void push(heap_timer* timer) throw ( std::exception )
+    void push(heap_timer* timer)
     {
-        if(timer == nullptr)
+        if(timer == nullptr || timer->_index != -1)
         {
             return;
         }
@@ -121,13 +122,13 @@ public:
         }
 
         //直接在尾部插入，然后向上调整即可
-        _array[_size] = timer;
+        set(_size, timer);
         ++_size;
 
         adjust_up(_size - 1);
     }
 
-    //删除指定定时器。
+    //删除并释放指定定时器
     void del_timer(heap_timer* timer)
     {
         if(timer == nullptr)
@@ -135,8 +136,34 @@ public:
             return;
         }
 
-        //为了保证堆的结构不被破坏，这里并不会实际将他删除，而是将执行函数清空的伪删除操作。
-        timer->fun = nullptr;
+        if(timer->_index != -1)
+        {
+            remove(timer->_index);
+        }
+        delete timer;
+    }
+
+    //定时器的到期时间修改后，将他调整到合适的位置上
+    void adjust_timer(heap_timer* timer)
+    {
+        if(timer == nullptr || timer->_index == -1)
+        {
+            return;
+        }
+
+        int index = timer->_index;
+        uint64_t old = _array[index].expire;
+        _array[index].expire = timer->_expire;
+
+        //提前到期向上调整，推迟到期向下调整
+        if(timer->_expire < old)
+        {
+            adjust_up(index);
+        }
+        else
+        {
+            adjust_down(index);
+        }
     }
 
     //获取堆顶元素
@@ -147,26 +174,40 @@ public:
             return nullptr;
         }
 
-        return _array[0];
+        return _array[0].timer;
     }
 
-    //出堆
-    void pop() 
+    //删除并释放堆顶定时器
+    void pop()
     {
-        //交换堆顶堆尾后直接从首部向下调整即可
-        std::swap(_array[0], _array[_size - 1]);
-        --_size;
+        if(empty())
+        {
+            return;
+        }
 
-        adjust_down(0);
+        heap_timer* timer = _array[0].timer;
+        remove(0);
+        delete timer;
     }
 
     //判断时间堆是否为空
-    bool empty() const 
-    { 
-        return _size == 0; 
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    int size() const
+    {
+        return _size;
     }
 
-    void reserve(int capacity) throw (std::exception)
+    //最早的到期时间，堆为空时返回0
+    uint64_t next_expire() const
+    {
+        return empty() ? 0 : _array[0].expire;
+    }
+
+    void reserve(int capacity)
     {
         //如果新容量没有之前的大， 则没必要扩容
         if(capacity <= _capacity)
@@ -175,76 +216,129 @@ public:
         }
 
         //开辟新空间
-        heap_timer** temp = new heap_timer* [capacity];
-        if(temp == nullptr)
-        {
-            throw std::exception();
-        }
+        heap_entry* temp = alloc_entries(capacity);
 
         //拷贝原数据
         for(int i = 0; i < _size; i++)
         {
             temp[i] = _array[i];
         }
-        //初始化剩余空间
-        for(int i = _size; i < capacity; i++)
-        {
-            temp[i] = nullptr;
-        }
 
-        delete[] _array;    //删除原空间    
+        free_entries(_array);   //删除原空间
 
         _array = temp;      //更新新空间
         _capacity = capacity;
     }
-    
 
     //以堆顶为基准执行定时事件
     void tick()
     {
-       time_t cur_time = time(nullptr);
-
-       while(empty())
-       {
-           if(_array[0] == nullptr)
-           {
-               return;
-           }
-
-           //如果堆顶没有超时，则剩下的不可能超时
-           if(_array[0]->_expire > cur_time)
-           {
-               break;
-           }
-           
-           //如果执行任务为空，则说明被伪删除，直接出堆即可
-           if(_array[0]->fun != nullptr)
-           {
-               _array[0]->fun(_array[0]->_user_data);   //执行定时任务
-           }
-           pop();   //处理完定时任务后出堆         
-       }
+        uint64_t cur_time = loop_clock::now();
+
+        while(!empty())
+        {
+            //如果堆顶没有超时，则剩下的不可能超时
+            if(_array[0].expire > cur_time)
+            {
+                break;
+            }
+
+            //先出堆再执行定时任务，回调中可以添加或删除其他定时器
+            heap_timer* timer = _array[0].timer;
+            remove(0);
+
+            if(timer->fun != nullptr)
+            {
+                timer->fun(timer->_user_data);   //执行定时任务
+            }
+
+            //回调中修改到期时间后重新push了自己，定时器已经回到堆中，不能释放
+            if(timer->_index == -1)
+            {
+                delete timer;
+            }
+        }
     }
 
 private:
-    //向下调整算法
+    //申请按缓存行对齐的数组，返回跳过前面HEAP_PAD个空位后的起始地址
+    static heap_entry* alloc_entries(int capacity)
+    {
+        void* mem = nullptr;
+        if(posix_memalign(&mem, HEAP_LINE_SIZE, sizeof(heap_entry) * (capacity + HEAP_PAD)) != 0)
+        {
+            throw std::bad_alloc();
+        }
+
+        return (heap_entry*)mem + HEAP_PAD;
+    }
+
+    static void free_entries(heap_entry* array)
+    {
+        free(array - HEAP_PAD);
+    }
+
+    //在下标index处放置定时器，同时记录下标
+    void set(int index, heap_timer* timer)
+    {
+        _array[index].expire = timer->_expire;
+        _array[index].timer = timer;
+        timer->_index = index;
+    }
+
+    //从堆中取出下标为index的定时器，不释放
+    void remove(int index)
+    {
+        _array[index].timer->_index = -1;
+        --_size;
+
+        //用堆尾元素填补空位，再根据大小向上或向下调整
+        if(index != _size)
+        {
+            _array[index] = _array[_size];
+            _array[index].timer->_index = index;
+
+            if(index > 0 && _array[index].expire < _array[(index - 1) / HEAP_ARITY].expire)
+            {
+                adjust_up(index);
+            }
+            else
+            {
+                adjust_down(index);
+            }
+        }
+    }
+
+    //向下调整算法，把待调整元素先拿出来，子节点依次上移，最后再放回空位，减少赋值次数
     void adjust_down(int root)
     {
+        heap_entry entry = _array[root];
         int parent = root;
-        int child = root * 2 + 1;
 
-        while(child < parent)
+        while(true)
         {
-            //选出子节点较小的那个
-            if(child + 1 < _size && _array[child] > _array[child + 1])
+            int first = parent * HEAP_ARITY + 1;
+            if(first >= _size)
             {
-                ++child;
+                break;
             }
 
-            //如果父节点比子节点大则进行交换，如果不大于则说明此时处理已完毕
-            if(_array[parent] > _array[child])
+            //选出子节点中最小的那个
+            int child = first;
+            int last = (first + HEAP_ARITY < _size) ? first + HEAP_ARITY : _size;
+            for(int i = first + 1; i < last; i++)
             {
-                std::swap(_array[parent], _array[child]);
+                if(_array[i].expire < _array[child].expire)
+                {
+                    child = i;
+                }
+            }
+
+            //如果父节点比子节点大则子节点上移，如果不大于则说明此时处理已完毕
+            if(_array[child].expire < entry.expire)
+            {
+                _array[parent] = _array[child];
+                _array[parent].timer->_index = parent;
             }
             else
             {
@@ -253,21 +347,25 @@ private:
 
             //继续往下更新
             parent = child;
-            child = parent * 2 + 1;
         }
+
+        _array[parent] = entry;
+        entry.timer->_index = parent;
     }
 
     //向上调整算法
     void adjust_up(int root)
     {
+        heap_entry entry = _array[root];
         int child = root;
-        int parent = (child - 1) / 2;
 
         while(child > 0)
         {
-            if(_array[parent] > _array[child])
+            int parent = (child - 1) / HEAP_ARITY;
+            if(entry.expire < _array[parent].expire)
             {
-                std::swap(_array[parent], _array[child]);
+                _array[child] = _array[parent];
+                _array[child].timer->_index = child;
             }
             else
             {
@@ -275,14 +373,15 @@ private:
             }
             //往上继续更新
             child = parent;
-            parent = (child - 1) / 2;
         }
+
+        _array[child] = entry;
+        entry.timer->_index = child;
     }
 
-    heap_timer** _array;    //数组
+    heap_entry* _array;     //数组
     int _capacity;          //数据容量
     int _size;              //当前数据个数
 };
 
 #endif // !__TIMER_HEAP_H__
-
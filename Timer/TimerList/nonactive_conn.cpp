@@ -9,8 +9,10 @@
 #include<errno.h>
 #include<netinet/in.h>
 #include<unistd.h>
+#include<string.h>
 
 #include"timer_list.h"
+#include"../TimerService/timer_service.h"
 const int MAX_LISTEN = 5;
 const int MAX_EVENT = 1024;
 const int MAX_BUFFER = 1024;
@@ -20,6 +22,7 @@ const int FD_LIMIT = 65535;
 static int pipefd[2];        //管道描述符
 static int epoll_fd = 0;     //epoll操作句柄
 static timer_list timer_lst; //定时器链表    
+static timer_service timer_svc; //驱动定时器链表的timerfd
 
 
 //设置非阻塞
@@ -54,6 +57,7 @@ void sig_handler(int sig)
 void set_sig_handler(int sig)
 {
     struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
     sa.sa_handler = sig_handler;
     sa.sa_flags |= SA_RESTART;  //重新调用被信号中断的系统函数
     sigfillset(&sa.sa_mask);    //将所有信号加入信号掩码中
@@ -64,11 +68,23 @@ void set_sig_handler(int sig)
     }
 }
 
-//alarm信号处理函数
+//timerfd到期时执行到期任务
 void timer_handler()
 {
     timer_lst.tick();   //执行到期任务
-    alarm(TIMESLOT);    //开始下一轮计时
+}
+
+//按链表中最早的到期时间重新设置timerfd，链表为空时取消定时
+void timer_rearm()
+{
+    uint64_t expire = timer_lst.next_expire();
+    if(expire == 0)
+    {
+        timer_svc.disarm();
+        return;
+    }
+
+    timer_svc.arm(expire);
 }
 
 //到时处理任务
@@ -84,16 +100,23 @@ void handler(client_data* user_data)
     close(user_data->sock_fd);
 
     printf("close fd : %d\n", user_data->sock_fd);
+    user_data->timer = nullptr;
 }
 
 int main(int argc, char*argv[])
 {
     if(argc <= 2)
     {
-        printf("输入参数：IP地址 端口号\n");
+        printf("输入参数：IP地址 端口号 [precise]\n");
         return 1;
     }
 
+    //默认使用粗粒度的循环时钟，precise使用CLOCK_MONOTONIC
+    if(argc > 3 && strcmp(argv[3], "precise") == 0)
+    {
+        loop_clock::set_precise(true);
+    }
+
     const char* ip = argv[1];   
     int port = atoi(argv[2]);
     
@@ -124,7 +147,7 @@ int main(int argc, char*argv[])
     }
     
     //创建epoll，现版本已忽略大小，给多少都无所谓
-    int epoll_fd = epoll_create(MAX_LISTEN);
+    epoll_fd = epoll_create(MAX_LISTEN);
     if(epoll_fd == -1)
     {
         printf("epoll create.\n");
@@ -143,15 +166,20 @@ int main(int argc, char*argv[])
     setnonblocking(pipefd[1]);  //将写端设为非阻塞
     epoll_add_fd(epoll_fd, pipefd[0]);    //将读端加入epoll监控集合
     
-    set_sig_handler(SIGALRM);   //设置定时信号
-    set_sig_handler(SIGTERM);   //用户按下中断键（DELETE或者Ctrl+C）
+    set_sig_handler(SIGTERM);   //终止进程
+    set_sig_handler(SIGINT);    //用户按下中断键（DELETE或者Ctrl+C）
+
+    //定时器由timerfd驱动，直接在epoll中监控，不再经过SIGALRM和信号管道
+    if(!timer_svc.init(epoll_fd))
+    {
+        return -1;
+    }
     
     struct epoll_event events[MAX_LISTEN];
     client_data* users = new client_data[FD_LIMIT];
 
     bool stop_server = false;
-    bool time_out;
-    alarm(TIMESLOT);    //开始计时
+    bool time_out = false;
     while(!stop_server)
     {
         int number = epoll_wait(epoll_fd, events, MAX_LISTEN, -1);
@@ -160,6 +188,9 @@ int main(int argc, char*argv[])
             printf("epoll_wait.\n");
             break;
         }
+
+        //每轮循环只采样一次时间，本轮所有定时器操作都使用这个值
+        loop_clock::update();
         
         for(int i = 0; i < number; i++)
         {
@@ -177,7 +208,7 @@ int main(int argc, char*argv[])
                     printf("accept.\n");
                     continue;
                 }
-                epoll_add_fd(epoll_fd, sock_fd);
+                epoll_add_fd(epoll_fd, conn_fd);
                 
                 //存储用户信息
                 users[conn_fd].addr = clinet_addr;
@@ -185,21 +216,25 @@ int main(int argc, char*argv[])
 
                 //创建定时器
                 util_timer* timer = new util_timer;
-                users->timer = timer;
+                users[conn_fd].timer = timer;
 
                 timer->_user_data = &users[conn_fd];
                 timer->fun = handler;
                 
-                time_t cur_time = time(nullptr);
-                timer->_expire = cur_time + 3 * TIMESLOT;    //设置超时时间
+                timer->_expire = loop_clock::now() + 3 * TIMESLOT * 1000;    //设置超时时间
                 
 
+                //所有连接的超时时间相同，新定时器直接追加到链表尾部
                 timer_lst.push(timer);  //将定时器放入定时器链表中
             }
+            //timerfd到期，本轮事件处理完后再执行到期任务
+            else if(sock_fd == timer_svc.fd())
+            {
+                time_out = timer_svc.handle();
+            }
             //如果就绪的是管道的读端，则说明有信号到来，要处理信号
             else if(sock_fd == pipefd[0] && events[i].events & EPOLLIN)
             {
-                int sig;
                 char signals[MAX_BUFFER];
 
                 int ret = recv(pipefd[0], signals, MAX_BUFFER, 0);
@@ -216,18 +251,13 @@ int main(int argc, char*argv[])
                     //由于一个信号占一个字节，所以按字节逐个处理信号
                     for(int j = 0; j < ret; j++)
                     {
-                        switch (signals[i])
+                        switch (signals[j])
                         {
-                            
-                            case SIGALRM:
-                            {
-                                time_out = true;
-                                break;
-                            }
-                            
+                            case SIGTERM:
                             case SIGINT:
                             {
                                 stop_server = true;
+                                break;
                             }
                         }
                     }
@@ -262,13 +292,11 @@ int main(int argc, char*argv[])
                 }
                 else
                 {
-                    //如果事件成功执行，则重新设置定时器的超时时间，并调整其在定时器链表中的位置
+                    //如果事件成功执行，则延后定时器的超时时间
+                    //只记录新的到期时间，定时器到达链表头部时才重新排队，频繁收发数据的连接不会每次都移动节点
                     if(timer)
                     {
-                        time_t cur_time = time(nullptr);
-                        timer->_expire = cur_time + 3 * TIMESLOT;
-
-                        timer_lst.adjust_node(timer);
+                        timer_lst.touch(timer, loop_clock::now() + 3 * TIMESLOT * 1000);
                     }
                 }
                 
@@ -285,6 +313,9 @@ int main(int argc, char*argv[])
             timer_handler();
             time_out = false;
         }
+
+        //本轮可能新增、延后或删除了定时器，按最早的到期时间重新设置timerfd
+        timer_rearm();
     }
     
     //关闭文件描述符
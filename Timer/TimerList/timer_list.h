@@ -5,7 +5,9 @@
 #include<stdio.h>
 #include<sys/socket.h>
 #include<sys/types.h>
+#include<stdint.h>
 #include<netinet/in.h>
+#include"../TimerService/loop_clock.h"
 
 const int MAX_BUFFER_SIZE = 1024;
 
@@ -25,11 +27,14 @@ struct util_timer
 {
     public:
         util_timer()
-            : _next(nullptr)
+            : _expire(0)
+            , _deadline(0)
+            , _next(nullptr)
             , _prev(nullptr)
         {}
 
-        time_t _expire;             //到期时间
+        uint64_t _expire;           //在链表中排序使用的到期时间，单位为ms，以loop_clock为准
+        uint64_t _deadline;         //真正的到期时间，连接活跃时只延后它，到达链表头部时再按它重新排队
         void (*fun)(client_data*);  //处理函数
         client_data* _user_data;    //用户参数
 
@@ -66,48 +71,38 @@ class timer_list
         {
             return;
         }
-        
-        //如果头节点为空，则让新节点成为头节点
-        if(_head == nullptr)
+
+        if(timer->_deadline < timer->_expire)
         {
-            _head = _tail = timer;
-            return;
+            timer->_deadline = timer->_expire;
+        }
+
+        //从尾部向前找插入的位置，所有定时器的超时时间相同时新定时器总是最晚到期，直接追加到尾部，不需要遍历
+        node* prev = _tail;
+        while(prev && timer->_expire < prev->_expire)
+        {
+            prev = prev->_prev;
         }
 
-        //如果节点比头节点小，则让他成为新的节点
-        if(timer->_expire < _head->_expire)
+        timer->_prev = prev;
+        //比所有节点都小，成为新的头节点
+        if(prev == nullptr)
         {
             timer->_next = _head;
-            _head->_prev = timer;   
             _head = timer;
-            return;
         }
-
-        node* prev = _head;
-        node* cur = _head->_next;
-
-        //找到插入的位置
-        while(cur)
+        else
         {
-            if(timer->_expire < cur->_expire)
-            {
-                timer->_next = cur;
-                cur->_prev = timer;
-                prev->_next = timer;
-                timer->_prev = prev;
-
-                return;
-            }
-            prev = cur;
-            cur = cur->_next;
+            timer->_next = prev->_next;
+            prev->_next = timer;
         }
 
-        //如果走到这里还没有返回，则说明当前定时器大于链表中所有节点，所以让他成为新的尾节点
-        if(cur == nullptr)
+        if(timer->_next)
+        {
+            timer->_next->_prev = timer;
+        }
+        else
         {
-            prev->_next = timer;
-            timer->_prev = prev;
-            timer->_next = nullptr;
             _tail = timer;
         }
     }
@@ -121,80 +116,43 @@ class timer_list
         }
 
         //先将节点从链表中取出，再插回去。
-        if(timer == _head && timer == _tail)
-        {
-            _head = _tail = nullptr;
-        }
-        //如果该节点是头节点
-        if(timer == _head)
-        {
-            _head = timer->_next;
-            if(_head)
-            {
-                _head->_prev = nullptr;
-            }
-        }
-        //如果该节点是尾节点
-        if(timer == _tail)
-        {
-            _tail = _tail->_prev;
-            if(_tail)
-            {
-                _tail->_next = nullptr;
-            }
-        }
-        //该节点在中间
-        else
-        {
-            timer->_prev->_next = timer->_next;
-            timer->_next->_prev = timer->_prev;
-        }
-        
-        //将节点重新插入回链表中
+        unlink(timer);
+        timer->_deadline = timer->_expire;
         push(timer);
     }
 
-    //删除指定定时器
-    void pop(node* timer)
+    //连接活跃时延后定时器，只记录新的到期时间，不移动节点
+    //节点到达链表头部并且发现还没有真正到期时，才会在tick中按新的到期时间重新排队
+    void touch(node* timer, uint64_t deadline)
     {
         if(timer == nullptr)
         {
             return;
         }
 
-        //如果链表中只有一个节点
-        if(timer == _head && timer == _tail)
+        if(deadline > timer->_deadline)
         {
-            delete timer;
-            _head = _tail = nullptr;
+            timer->_deadline = deadline;
         }
-        //如果删除的是头节点
-        else if(timer == _head)
-        {
-            _head = _head->_next;
-            _head->_prev = nullptr;
+    }
 
-            delete timer;
-            timer = nullptr;
-        }
-        //如果删除的是尾节点
-        else if(timer == _tail)
+    //删除指定定时器
+    void pop(node* timer)
+    {
+        if(timer == nullptr)
         {
-            _tail = _tail->_prev;
-            _tail->_next = nullptr;
-
-            delete timer;
-            timer = nullptr;
+            return;
         }
-        else
-        {
-            //此时删除节点就是中间的节点
-            timer->_prev->_next = timer->_next;
-            timer->_next->_prev = timer->_prev;
 
-            delete timer;
-            timer = nullptr;
-        }
+        unlink(timer);
+        delete timer;
+    }
+
+    //最早的到期时间，链表为空时返回0
+    //返回的是排序使用的到期时间，被延后的定时器会在这个时刻重新排队
+    uint64_t next_expire() const
+    {
+        return _head ? _head->_expire : 0;
     }
 
     //处理链表上的到期任务
@@ -207,34 +165,60 @@ class timer_list
         }
         printf("time tick\n");
 
-        time_t cur_time = time(nullptr);    //获取当前时间
-        
-        node* cur = _head;
-        while(cur)
+        uint64_t cur_time = loop_clock::now();  //本轮循环采样的当前时间
+
+        while(_head)
         {
+            node* cur = _head;
+
             //由于链表是按照到期时间进行排序的，所以如果当前节点没到期，后面的也不可能到期
             if(cur->_expire > cur_time)
             {
                 break;
             }
-            //如果当前节点到期，则调用回调函数执行定时任务。
-            cur->fun(cur->_user_data);
 
-            //执行完定时任务后，将节点从链表中删除
-            node* next = cur->_next;
-            //前指针置空
-            if(next != nullptr)
+            unlink(cur);
+
+            //连接在排队期间活跃过，按真正的到期时间重新排队
+            if(cur->_deadline > cur_time)
             {
-                next->_prev = nullptr;
+                cur->_expire = cur->_deadline;
+                push(cur);
+                continue;
             }
 
+            //如果当前节点到期，则调用回调函数执行定时任务，执行完后删除节点
+            cur->fun(cur->_user_data);
             delete cur;
-            cur = next;
         }
     }
 
     private:
+    //将节点从链表中取出，不释放
+    void unlink(node* timer)
+    {
+        if(timer->_prev)
+        {
+            timer->_prev->_next = timer->_next;
+        }
+        else
+        {
+            _head = timer->_next;
+        }
+
+        if(timer->_next)
+        {
+            timer->_next->_prev = timer->_prev;
+        }
+        else
+        {
+            _tail = timer->_prev;
+        }
+
+        timer->_next = timer->_prev = nullptr;
+    }
+
         node* _head;
         node* _tail;
 };
-#endif // !__TIMER_LIST_H__
\ No newline at end of file
+#endif // !__TIMER_LIST_H__
@@ -0,0 +1,72 @@
+#ifndef __LOOP_CLOCK_H__
+#define __LOOP_CLOCK_H__
+
+#include<time.h>
+#include<stdint.h>
+
+//事件循环时钟，每轮循环在epoll_wait返回后采样一次，定时器和连接活跃时间都读取缓存的值，不再各自调用time
+//默认使用CLOCK_MONOTONIC_COARSE，读取时不需要访问时钟硬件，精度为一个时钟节拍(通常1到4ms)
+//高精度模式使用CLOCK_MONOTONIC，两者都不受系统时间调整的影响
+class loop_clock
+{
+public:
+    //切换高精度模式，并立即重新采样
+    static void set_precise(bool precise)
+    {
+        precise_ref() = precise;
+        update();
+    }
+
+    static bool precise()
+    {
+        return precise_ref();
+    }
+
+    //重新采样当前时间，每轮事件循环调用一次
+    static uint64_t update()
+    {
+        struct timespec ts;
+        clock_gettime(precise_ref() ? CLOCK_MONOTONIC : CLOCK_MONOTONIC_COARSE, &ts);
+
+        now_ref() = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+        return now_ref();
+    }
+
+    //本轮循环采样的时间，还没有采样过时先采样一次
+    static uint64_t now()
+    {
+        uint64_t now = now_ref();
+        return now ? now : update();
+    }
+
+    //粗粒度时钟比CLOCK_MONOTONIC最多落后的毫秒数，高精度模式下为0
+    static uint64_t slack()
+    {
+        if(precise_ref())
+        {
+            return 0;
+        }
+
+        struct timespec res;
+        clock_getres(CLOCK_MONOTONIC_COARSE, &res);
+
+        return (uint64_t)res.tv_sec * 1000 + (res.tv_nsec + 999999) / 1000000;
+    }
+
+private:
+    //本线程事件循环缓存的当前时间，单位ms，每个线程各自一份
+    //放在内联函数的局部静态变量中，所有包含本头文件的编译单元共用同一份，不能定义成文件作用域的static变量
+    static uint64_t& now_ref()
+    {
+        static __thread uint64_t t_loop_now = 0;
+        return t_loop_now;
+    }
+
+    static bool& precise_ref()
+    {
+        static __thread bool t_loop_precise = false;
+        return t_loop_precise;
+    }
+};
+
+#endif // !__LOOP_CLOCK_H__
@@ -0,0 +1,125 @@
+#ifndef __TIMER_SERVICE_H__
+#define __TIMER_SERVICE_H__
+
+#include<time.h>
+#include<stdio.h>
+#include<stdint.h>
+#include<errno.h>
+#include<unistd.h>
+#include<sys/epoll.h>
+#include<sys/timerfd.h>
+#include"loop_clock.h"
+
+//定时器的驱动源，每个事件循环一个timerfd
+//每轮循环结束时按定时器容器中最早的到期时间设置timerfd，到期时epoll直接返回timerfd可读，不再需要alarm和信号管道
+class timer_service
+{
+public:
+    timer_service()
+        : _fd(-1)
+        , _armed(0)
+    {}
+
+    ~timer_service()
+    {
+        if(_fd != -1)
+        {
+            close(_fd);
+        }
+    }
+
+    //防拷贝
+    timer_service(const timer_service&) = delete;
+    timer_service& operator=(const timer_service&) = delete;
+
+    //创建timerfd并加入epoll监控集合
+    bool init(int epoll_fd)
+    {
+        _fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if(_fd == -1)
+        {
+            perror("timerfd_create");
+            return false;
+        }
+
+        struct epoll_event event;
+        event.data.fd = _fd;
+        event.events = EPOLLIN;
+
+        if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, _fd, &event) == -1)
+        {
+            perror("epoll_ctl timerfd");
+            close(_fd);
+            _fd = -1;
+            return false;
+        }
+
+        return true;
+    }
+
+    int fd() const
+    {
+        return _fd;
+    }
+
+    //在loop_clock的expire_ms时刻到期，已经过去的时刻会立即到期，0表示取消
+    bool arm(uint64_t expire_ms)
+    {
+        //到期时间没有变化时不需要再次进入内核
+        if(expire_ms == _armed)
+        {
+            return true;
+        }
+
+        //粗粒度的循环时钟比timerfd使用的CLOCK_MONOTONIC落后，推迟一个时钟节拍到期
+        //否则timerfd到期时循环时钟可能还没走到到期时间，定时器不会执行，事件循环会反复被唤醒
+        uint64_t value = expire_ms ? expire_ms + loop_clock::slack() : 0;
+
+        struct itimerspec its;
+        its.it_interval.tv_sec = 0;
+        its.it_interval.tv_nsec = 0;
+        its.it_value.tv_sec = value / 1000;
+        its.it_value.tv_nsec = (value % 1000) * 1000000;
+
+        if(timerfd_settime(_fd, TFD_TIMER_ABSTIME, &its, nullptr) == -1)
+        {
+            perror("timerfd_settime");
+            return false;
+        }
+
+        _armed = expire_ms;
+        return true;
+    }
+
+    //在delay_ms毫秒之后到期
+    bool arm_after(uint64_t delay_ms)
+    {
+        return arm(loop_clock::now() + delay_ms);
+    }
+
+    //取消定时
+    bool disarm()
+    {
+        return arm(0);
+    }
+
+    //timerfd可读时调用，读出到期次数，返回是否真的到期
+    bool handle()
+    {
+        uint64_t count = 0;
+        ssize_t ret = read(_fd, &count, sizeof(count));
+        if(ret != sizeof(count))
+        {
+            return false;
+        }
+
+        _armed = 0;
+        return true;
+    }
+
+private:
+    int _fd;            //timerfd
+    uint64_t _armed;    //当前设置的到期时刻，0表示没有设置
+};
+
+#endif // !__TIMER_SERVICE_H__
@@ -3,13 +3,25 @@
 
 #include<time.h>
 #include<stdio.h>
+#include<stdint.h>
 #include<netinet/in.h>
+#include"../TimerService/loop_clock.h"
 
 const int MAX_BUFFER_SIZE = 1024;
-const int SLOT_COUNT = 60;
-const int SLOT_INERTVAL = 1;
 
-class util_timer;
+//分层时间轮，每个槽位代表1ms
+//第0层256个槽，精确到1ms；后面三层各64个槽，每个槽分别代表256ms、16s、17min
+//最远可以表示2^26ms(约18.6小时)，更远的定时器先放在最高层，降级时再重新计算
+const int TW_ROOT_BITS = 8;
+const int TW_LEVEL_BITS = 6;
+const int TW_ROOT_SIZE = 1 << TW_ROOT_BITS;
+const int TW_LEVEL_SIZE = 1 << TW_LEVEL_BITS;
+const int TW_ROOT_MASK = TW_ROOT_SIZE - 1;
+const int TW_LEVEL_MASK = TW_LEVEL_SIZE - 1;
+const int TW_LEVEL_COUNT = 3;   //第0层以外的层数
+const uint64_t TW_MAX_TICKS = (1ULL << (TW_ROOT_BITS + TW_LEVEL_BITS * TW_LEVEL_COUNT)) - 1;
+
+struct tw_timer;
 
 //用户数据
 struct client_data
@@ -17,64 +29,75 @@ struct client_data
     sockaddr_in addr;
     int sock_fd;
     char buff[MAX_BUFFER_SIZE];
-    util_timer* timer;
+    tw_timer* timer;
 };
 
-//定时器类
+//定时器类，链表节点直接放在定时器中，插入和删除都不需要额外分配内存
 struct tw_timer
 {
     public:
-        tw_timer(int rot, int ts)
-            : _rotation(rot)
-            , _time_slot(ts)
+        tw_timer(uint64_t expire)
+            : _expire(expire)
+            , fun(nullptr)
+            , _user_data(nullptr)
             , _next(nullptr)
             , _prev(nullptr)
+            , _slot(nullptr)
         {}
 
-        
-        int _rotation;   //旋转的圈数
-        int _time_slot;  //记录在哪一个槽中
+        uint64_t _expire;           //到期的时刻，单位为ms
         void (*fun)(client_data*);  //处理函数
         client_data* _user_data;    //用户参数
 
         tw_timer* _next;
         tw_timer* _prev;
+        tw_timer** _slot;           //所在槽的头指针，不在时间轮中时为空，删除时不需要知道在哪一层
 };
 
-//定时器链表，带头尾双向链表，定时器以升序排序
+//分层时间轮，插入、删除、到期都是O(1)
+//到期时间较远的定时器放在高层的粗粒度槽中，只有低层转完一圈时才把高层的一个槽降级到低层，远期定时器不会在每次tick时被访问
 class timer_wheel
 {
     public:
-    timer_wheel()
-        : cur_slot(0)
+    timer_wheel(uint64_t now = loop_clock::now())
+        : _cur(now)
+        , _count(0)
     {
         //初始化每个槽的头节点
-        for(int i = 0; i < SLOT_COUNT; i++)
+        for(int i = 0; i < TW_ROOT_SIZE; i++)
         {
-            _slots[i] = nullptr;
+            _root[i] = nullptr;
+        }
+        for(int i = 0; i < TW_LEVEL_COUNT; i++)
+        {
+            for(int j = 0; j < TW_LEVEL_SIZE; j++)
+            {
+                _levels[i][j] = nullptr;
+            }
         }
     }
 
     ~timer_wheel()
     {
-        for(int i = 0; i < SLOT_COUNT; i++)
+        //删除每一个槽中的所有节点
+        for(int i = 0; i < TW_ROOT_SIZE; i++)
+        {
+            clear_slot(_root[i]);
+        }
+        for(int i = 0; i < TW_LEVEL_COUNT; i++)
         {
-            //删除每一个槽中的所有节点
-            tw_timer* cur = _slots[i];
-            while(cur)
+            for(int j = 0; j < TW_LEVEL_SIZE; j++)
             {
-                tw_timer* next = cur->_next;
-                delete cur;
-                cur = next;
+                clear_slot(_levels[i][j]);
             }
-        }        
+        }
     }
 
     //防拷贝
     timer_wheel(const timer_wheel&) = delete;
     timer_wheel& operator=(const timer_wheel&) = delete;
 
-    //根据超时时间新建定时器并插入时间轮中
+    //根据超时时间(ms)新建定时器并插入时间轮中
     tw_timer* add_timer(int time_out)
     {
         //如果超时时间为负数则直接返回
@@ -83,121 +106,269 @@ class timer_wheel
             return nullptr;
         }
 
-        int ticks = 0;  //移动多少个槽时触发
-        //如果超时时间小于一个时间间隔，则槽数取整为1
-        if(time_out < SLOT_INERTVAL)
+        tw_timer* timer = new tw_timer(base() + ticks_of(time_out));
+        place(timer);
+        _count++;
+
+        return timer;
+    }
+
+    //修改定时器的超时时间，重新计算所在的槽，不需要重新分配
+    //可以在到期回调中重新设置正在执行的定时器，实现周期定时，此时tick不会释放它
+    void mod_timer(tw_timer* timer, int time_out)
+    {
+        if(timer == nullptr || time_out < 0)
         {
-            ticks = 1;
+            return;
         }
-        else
+
+        if(timer->_slot != nullptr)
         {
-            //计算移动的槽数
-            ticks = time_out / SLOT_INERTVAL;
+            unlink(timer);
+            _count--;
         }
 
-        int rotation = ticks / SLOT_COUNT;  //计算插入的定时器移动多少圈后会被触发
-        int time_slot = (cur_slot + (ticks % SLOT_COUNT) % SLOT_COUNT);  //计算其应该插入的槽位
+        timer->_expire = base() + ticks_of(time_out);
+        place(timer);
+        _count++;
+    }
 
-        tw_timer* timer = new tw_timer(rotation, time_slot);
-        //如果要插入的槽为空，则成为该槽的头节点
-        if(_slots[time_slot] == nullptr)
+    //删除指定定时器，回调函数中不能删除正在执行的定时器，回调返回后tick会负责释放
+    void del_timer(tw_timer* timer)
+    {
+        if(timer == nullptr)
         {
-            _slots[time_slot] = timer;
+            return;
         }
-        //否则头插进入该槽中
-        else
-        {
-            timer->_next = _slots[time_slot];
-            _slots[time_slot]->_prev = timer;
 
-            _slots[time_slot] = timer;
+        if(timer->_slot != nullptr)
+        {
+            unlink(timer);
+            _count--;
         }
+        delete timer;
+    }
 
-        return timer;
+    //时间轮中的定时器个数
+    size_t size() const
+    {
+        return _count;
     }
 
-    //删除指定定时器
-    void del_timer(tw_timer* timer)
+    //最早的到期时间，没有定时器时返回0
+    //每一层从当前位置开始找第一个非空的槽，同一层中越靠后的槽到期越晚，最多扫描256+3*64个槽
+    //第0层靠后的槽可能比高层的下一个槽更晚，所以要取所有层中最小的
+    uint64_t next_expire() const
     {
-        if(timer == nullptr)
+        if(_count == 0)
         {
-            return;
+            return 0;
         }
 
-        int time_slot = timer->_time_slot;
-        //如果该定时器为槽的头节点，则让下一个节点成为新的头节点
-        if(timer == _slots[time_slot])
+        uint64_t expire = 0;
+
+        //第0层同一个槽中的定时器到期时间相同
+        for(int i = 0; i < TW_ROOT_SIZE; i++)
         {
-            _slots[time_slot] = _slots[time_slot]->_next;
-            if(_slots[time_slot])
+            tw_timer* head = _root[(_cur + i) & TW_ROOT_MASK];
+            if(head)
             {
-                _slots[time_slot]->_prev = nullptr;
+                expire = (head->_expire < _cur) ? _cur : head->_expire;
+                break;
             }
-            delete timer;
-            timer = nullptr;
         }
-        //此时槽为中间节点，正常的链表删除操作即可
-        else
+
+        //高层的一个槽中到期时间各不相同，需要遍历找出最小的
+        //_cur正好在本层的槽边界上时，当前槽要等下一次tick才降级，里面是马上到期的定时器，需要先查
+        //否则当前槽已经降级过，里面只可能是下一圈的定时器，所以最后再查
+        for(int i = 0; i < TW_LEVEL_COUNT; i++)
         {
-            timer->_prev->_next = timer->_next;
-            if(timer->_next)
+            int shift = TW_ROOT_BITS + i * TW_LEVEL_BITS;
+            int index = (_cur >> shift) & TW_LEVEL_MASK;
+            int first = (_cur & ((1ULL << shift) - 1)) == 0 ? 0 : 1;
+            for(int j = first; j < first + TW_LEVEL_SIZE; j++)
             {
-                timer->_next->_prev = timer->_prev;
+                tw_timer* cur = _levels[i][(index + j) & TW_LEVEL_MASK];
+                if(cur == nullptr)
+                {
+                    continue;
+                }
+
+                for(; cur; cur = cur->_next)
+                {
+                    if(expire == 0 || cur->_expire < expire)
+                    {
+                        expire = cur->_expire;
+                    }
+                }
+                break;
             }
-            delete timer;
-            timer = nullptr;
-        } 
+        }
+
+        return expire;
     }
 
-    //处理当前槽的定时事件，并使时间轮转动一个槽
-    void tick()
+    //处理到now为止的所有到期定时器，时间轮每次转动一个1ms的槽
+    void tick(uint64_t now = loop_clock::now())
     {
-        tw_timer* cur = _slots[cur_slot];
-        while(cur)
+        while(_cur <= now)
         {
-            //如果不在本轮进行处理，则轮数减一后跳过
-            if(cur->_rotation > 0)
+            //时间轮中没有定时器，直接转到当前时刻
+            if(_count == 0)
             {
-                --cur->_rotation;
-                cur = cur->_next;
+                _cur = now + 1;
+                break;
             }
-            //本轮需要处理的定时器，执行定时任务后将其删除
-            else
-            {
-                cur->fun(cur->_user_data);
 
-                //如果删除的是头节点
-                if(cur == _slots[cur_slot])
+            int index = _cur & TW_ROOT_MASK;
+
+            //第0层转完一圈，依次把上一层的当前槽降级到下一层
+            if(index == 0)
+            {
+                for(int i = 0; i < TW_LEVEL_COUNT; i++)
                 {
-                    _slots[cur_slot] = cur->_next;
-                    if(_slots[cur_slot])
+                    int slot = (_cur >> (TW_ROOT_BITS + i * TW_LEVEL_BITS)) & TW_LEVEL_MASK;
+                    cascade(_levels[i][slot]);
+
+                    //本层没有转完一圈，更高层不需要降级
+                    if(slot != 0)
                     {
-                        _slots[cur_slot]->_prev = nullptr;
+                        break;
                     }
-                    delete cur;
-                    cur = _slots[cur_slot];
                 }
-                //删除的是中间节点
-                else
+            }
+
+            //当前槽中的定时器全部到期，先从槽中取下再执行回调，回调中可以添加或删除其他定时器
+            while(_root[index] != nullptr)
+            {
+                tw_timer* timer = _root[index];
+                unlink(timer);
+                _count--;
+
+                timer->fun(timer->_user_data);
+
+                //回调中用mod_timer重新设置了自己，定时器已经回到时间轮中，不能释放
+                if(timer->_slot == nullptr)
                 {
-                    cur->_prev->_next = cur->_next;
-                    if(cur->_next)
-                    {
-                        cur->_next->_prev = cur->_prev;
-                    }       
-                    tw_timer* next = cur->_next;
-                    delete cur;
-                    cur = next;
+                    delete timer;
                 }
             }
+
+            _cur++;
         }
-        //本槽处理完成，时间轮转动一个槽位
-        cur_slot = (cur_slot + 1) % SLOT_COUNT;
     }
 
     private:
-        tw_timer* _slots[SLOT_COUNT];   //时间轮的槽，每个槽的元素为一个无序定时器链表
-        int cur_slot;                   //当前指向的槽
+    //计算到期时间的起点，两次tick之间_cur停在上一次tick，要以当前时间为准
+    //刚tick完时_cur是now+1，此时取_cur，保证定时器不会落到已经处理过的槽中
+    uint64_t base() const
+    {
+        uint64_t now = loop_clock::now();
+        return (now > _cur) ? now : _cur;
+    }
+
+    //超时时间换算成槽数，不足一个槽的按一个槽计算
+    static uint64_t ticks_of(int time_out)
+    {
+        return (time_out < 1) ? 1 : time_out;
+    }
+
+    //根据到期时间和当前时刻的距离选择所在的层和槽
+    void place(tw_timer* timer)
+    {
+        uint64_t expire = timer->_expire;
+
+        //已经过期的定时器放到当前槽，下一次tick时执行
+        if(expire < _cur)
+        {
+            expire = _cur;
+        }
+
+        uint64_t delta = expire - _cur;
+        //超出时间轮范围的定时器先放在最高层最远的槽中，降级时会按真实的到期时间重新放置
+        if(delta > TW_MAX_TICKS)
+        {
+            expire = _cur + TW_MAX_TICKS;
+            delta = TW_MAX_TICKS;
+        }
+
+        tw_timer** slot = nullptr;
+        if(delta < (uint64_t)TW_ROOT_SIZE)
+        {
+            slot = &_root[expire & TW_ROOT_MASK];
+        }
+        else
+        {
+            for(int i = 0; i < TW_LEVEL_COUNT; i++)
+            {
+                int shift = TW_ROOT_BITS + i * TW_LEVEL_BITS;
+                if(delta < (1ULL << (shift + TW_LEVEL_BITS)) || i == TW_LEVEL_COUNT - 1)
+                {
+                    slot = &_levels[i][(expire >> shift) & TW_LEVEL_MASK];
+                    break;
+                }
+            }
+        }
+
+        //头插进入该槽中
+        timer->_prev = nullptr;
+        timer->_next = *slot;
+        if(*slot)
+        {
+            (*slot)->_prev = timer;
+        }
+        *slot = timer;
+        timer->_slot = slot;
+    }
+
+    //将定时器从所在的槽中取下
+    void unlink(tw_timer* timer)
+    {
+        if(timer->_prev)
+        {
+            timer->_prev->_next = timer->_next;
+        }
+        else
+        {
+            *timer->_slot = timer->_next;
+        }
+        if(timer->_next)
+        {
+            timer->_next->_prev = timer->_prev;
+        }
+
+        timer->_next = timer->_prev = nullptr;
+        timer->_slot = nullptr;
+    }
+
+    //把高层的一个槽中的定时器按剩余时间重新放置到低层
+    void cascade(tw_timer*& head)
+    {
+        tw_timer* cur = head;
+        head = nullptr;
+
+        while(cur)
+        {
+            tw_timer* next = cur->_next;
+            place(cur);
+            cur = next;
+        }
+    }
+
+    static void clear_slot(tw_timer* cur)
+    {
+        while(cur)
+        {
+            tw_timer* next = cur->_next;
+            delete cur;
+            cur = next;
+        }
+    }
+
+    tw_timer* _root[TW_ROOT_SIZE];                      //第0层的槽，每个槽的元素为一个无序定时器链表
+    tw_timer* _levels[TW_LEVEL_COUNT][TW_LEVEL_SIZE];   //第1到3层的槽
+    uint64_t _cur;                                      //下一个要处理的时刻，单位为ms
+    size_t _count;                                      //定时器个数
 };
 
 #endif // !__TIMER_WHEEL_H__